@@ -0,0 +1,1332 @@
+/*
+ *    diffmatr.c --- list the cycles and the generators of the chain complex
+ *                   of a link diagram and compute the matrices of its
+ *                   differentials in the packed sparse format, the latter
+ *                   two in several threads.
+ *
+ * Copyright (C) 2002--2018 Alexander Shumakovitch <Shurik@gwu.edu>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see COPYING.gz. If not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *
+ * To load from PARI/GP:
+ *    install(list_cycles, "GGD0,L,", list_cycles, "./diffmatr.so")
+ *    install(list_regions, "GG", list_regions, "./diffmatr.so")
+ *    install(list_states, "GLLLLLD0,L,", list_states, "./diffmatr.so")
+ *    install(get_d_matrices, "GGGGGLLLD0,L,", get_d_matrices,
+ *						"./diffmatr.so")
+ *    install(check_d_squared, "GGLD0,L,", check_d_squared, "./diffmatr.so")
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <pari/pari.h>
+
+#if PARI_VERSION_CODE > PARI_VERSION(2,7,0)
+#  define talker e_MISC
+#endif
+
+/* the same as jN_mask in KhoHo_gvars: enhanced states are packed as
+ * j-grading * JN_MASK + generator number in states_info */
+#define JN_MASK (1L << 26)
+
+/* the same as arch64_mask in KhoHo_gvars */
+#define ARCH64_MASK (1L << 32)
+
+/* never start more threads than that */
+#define MAX_THREADS 256
+
+/* number of chunks of states per thread when listing the generators */
+#define CHUNKS_PER_THREAD 16
+
+/* maximal number of cycles in a state (the number of generators has to fit
+ * into a long) */
+#define MAX_CYCLES 62
+
+/* d^2 = 0 is checked by applying it to that many random vectors modulo
+ * D2_PRIME. A non-zero d^2 is missed with probability at most D2_PRIME^-2. */
+#define D2_VECTORS 2
+#define D2_PRIME 2147483647UL
+
+/*
+ * Work on a single primary grading. Members are:
+ *   number of 1-smoothings in the states of this grading,
+ *   matrices of differentials for every j-grading (preallocated VECSMALLs),
+ *   number of entries written to every matrix so far.
+ */
+typedef struct dmatr_task {
+	long ones;
+	GEN matrices;
+	long *lengths;
+} DmatrTask;
+
+/*
+ * Chunk of consecutive (unenhanced) states to list the generators of.
+ * Members are:
+ *   the first state in the chunk and the one after the last (from 0),
+ *   numbers of generators of every C^{i,j}(D) in the chunk, replaced by
+ *   the numbers of those in all the chunks before it before numbering them,
+ *   lengths of the matrices of differentials added by the chunk.
+ * Both arrays are indexed by (i_matr - 1) * j_size + j_matr - 1.
+ */
+typedef struct states_chunk {
+	unsigned long first, last;
+	long *ranks, *lengths;
+} StatesChunk;
+
+/*
+ * Data shared by all the threads. The number of the next task to take is
+ * guarded by the lock, the rest is read only (or written by one thread only).
+ * An error (if any) is reported in err_message.
+ */
+static GEN states_info = NULL;			// states_info[datapos]
+static GEN arrow_starts = NULL;			// where resolution arrows start
+static GEN edge_signs = NULL;			// signs of edges in odd homology
+static long num_crossings = 0;
+static int do_odd = 0, do_reduced = 0;		// which homology
+static long j_size = 0;				// number of j-gradings
+static DmatrTask *grading_tasks = NULL;
+static long num_gradings = 0;
+static long *xing_edges = NULL;			// 4 edges at every crossing
+static long num_edges = 0;			// including trivial components
+static long writhe_num = 0, j_high = 0;
+static int *state_cycnums = NULL;		// number of cycles in every state
+static StatesChunk *chunks = NULL;
+static long num_chunks = 0;
+static long binomials[MAX_CYCLES + 1][MAX_CYCLES + 1];
+static GEN d2_matrices = NULL, d2_ranks = NULL;	// matrices to check d^2 of
+static long d2_i_first = 0;			// i_matr of d2_matrices[1]
+static char *d2_failures = NULL;		// what's wrong with every d^2
+static int (*task_func)(long) = NULL;		// what the threads do
+static long num_tasks = 0, next_task = 0;
+static pthread_mutex_t task_lock = PTHREAD_MUTEX_INITIALIZER;
+static char *err_message = NULL;
+
+/*
+ * Entry number k of a vector, which can be either a VECSMALL or a vector
+ * of (small) integers.
+ */
+static inline long vec_entry(GEN vec, long k)
+{
+	if (typ(vec) == t_VECSMALL) return vec[k];
+
+	return itos((GEN) vec[k]);
+}
+
+/*
+ * Return the j-grading and the generator number of an enhanced state (s, S),
+ * packed as in states_info. The same as get_en_state in KhoHo_chain.
+ */
+static inline long get_en_state(long s, long S)
+{
+	GEN en_states = (GEN) ((GEN) states_info[s])[5];
+
+#ifdef LONG_IS_64BIT
+	long en_state = vec_entry(en_states, (S + 1) / 2);
+
+	return (S % 2 == 1) ? en_state % ARCH64_MASK : en_state / ARCH64_MASK;
+#else
+	return vec_entry(en_states, S);
+#endif
+}
+
+/*
+ * Record a failure, unless there is one already.
+ */
+static void set_error(char *message)
+{
+	pthread_mutex_lock(&task_lock);
+	if (err_message == NULL) err_message = message;
+	pthread_mutex_unlock(&task_lock);
+}
+
+/*
+ * Append the entry corresponding to the enhanced states (s, S) and (t, T)
+ * with a given value (+1 or -1) to the matrix of its j-grading in the packed
+ * format. The same as putDentry and putPentry in KhoHo_chain.
+ */
+static int put_d_entry(DmatrTask *task, long s, long S, long t, long T,
+								long sgn)
+{
+	long en_state_S = get_en_state(s, S), en_state_T = get_en_state(t, T);
+	long j = en_state_S / JN_MASK;
+	long row = en_state_T % JN_MASK, col = en_state_S % JN_MASK;
+	GEN matr;
+
+	if (j < 1 || j > j_size) {
+		set_error("get_d_matrices: wrong grading");
+		return -1;
+	}
+
+	matr = (GEN) task->matrices[j];
+#ifdef LONG_IS_64BIT
+	if (++task->lengths[j - 1] >= lg(matr)) {
+		set_error("get_d_matrices: wrong length of a matrix");
+		return -1;
+	}
+	matr[task->lengths[j - 1]] = sgn * (row * ARCH64_MASK + col);
+#else
+	if (2 * ++task->lengths[j - 1] >= lg(matr)) {
+		set_error("get_d_matrices: wrong length of a matrix");
+		return -1;
+	}
+	matr[2 * task->lengths[j - 1] - 1] = row;
+	matr[2 * task->lengths[j - 1]] = sgn * col;
+#endif
+
+	return 0;
+}
+
+/*
+ * Append the entries corresponding to the (unenhanced) states s and t that
+ * differ by the smoothing of a single crossing, astart being the edge where
+ * the arrow representing the resolution orientation starts. This follows
+ * putDentries in KhoHo_chain line by line, see the comments there.
+ */
+static int put_d_entries(DmatrTask *task, long s, long t, long sgn,
+								long astart)
+{
+	GEN s_info = (GEN) states_info[s], t_info = (GEN) states_info[t];
+	long s_cycnum = itos((GEN) s_info[2]), t_cycnum = itos((GEN) t_info[2]);
+	GEN s_incycles = (GEN) s_info[3], s_baseedge = (GEN) s_info[4];
+	GEN t_incycles = (GEN) t_info[3], t_baseedge = (GEN) t_info[4];
+	long i, born_cycle = -1, split_cycle, is_arrow_from_born = 0;
+	long s_mask, b_mask, bs_mask, en_state, n_states, step;
+	long s_template, b_template, sign_correction = 1;
+	long M_upto_split, M_upto_born, P_upto_split = 0, P_upto_born = 0;
+	int res = 0;
+
+	for (i = 1; i <= s_cycnum && i <= t_cycnum; i++)
+		if (vec_entry(s_baseedge, i) != vec_entry(t_baseedge, i)) {
+			born_cycle = i;
+			break;
+		}
+	if (born_cycle == -1)
+		born_cycle = (s_cycnum > t_cycnum) ? s_cycnum : t_cycnum;
+
+	if (t_cycnum > s_cycnum) {
+		split_cycle = vec_entry(s_incycles,
+				vec_entry(t_baseedge, born_cycle));
+		is_arrow_from_born =
+			(vec_entry(t_incycles, astart) == born_cycle);
+	} else
+		split_cycle = vec_entry(t_incycles,
+				vec_entry(s_baseedge, born_cycle));
+
+	s_mask = 1L << (split_cycle - 1);
+	b_mask = 1L << (born_cycle - 1);
+	bs_mask = b_mask + s_mask;
+
+	n_states = 1L << (((s_cycnum < t_cycnum) ? s_cycnum : t_cycnum) - 1);
+	step = 1 + (do_reduced && (split_cycle != 1));
+
+	for (en_state = 0; en_state < n_states && res == 0; en_state += step) {
+		s_template = (en_state & (s_mask - 1)) +
+			((en_state >> (split_cycle - 1)) << split_cycle);
+		b_template = (s_template & (b_mask - 1)) +
+			((s_template >> (born_cycle - 1)) << born_cycle);
+
+		if (do_odd) {
+			M_upto_split = __builtin_popcountl(en_state &
+							(s_mask - 1));
+			M_upto_born = __builtin_popcountl(en_state &
+							(b_mask / 2 - 1));
+
+			P_upto_split = (split_cycle - 1) - M_upto_split;
+			P_upto_born = (born_cycle - 2) - M_upto_born;
+		}
+
+		s_template++;
+		b_template++;
+
+		if (t_cycnum > s_cycnum) {	/* --- comultiplication --- */
+			if (do_reduced != split_cycle) {
+				/* (-) --> (-, +) */
+				if (do_odd) sign_correction = ((is_arrow_from_born
+					+ 1 + P_upto_born) % 2) ? -1 : 1;
+				res |= put_d_entry(task, s, s_template + s_mask,
+					t, b_template + s_mask,
+					sign_correction * sgn);
+
+				/* (-) --> (+, -) */
+				if (do_odd) sign_correction = ((is_arrow_from_born
+					+ P_upto_split) % 2) ? -1 : 1;
+				res |= put_d_entry(task, s, s_template + s_mask,
+					t, b_template + b_mask,
+					sign_correction * sgn);
+			}
+
+			/* (+) --> (+, +) */
+			if (do_odd) sign_correction = ((is_arrow_from_born
+					+ P_upto_born) % 2) ? -1 : 1;
+			res |= put_d_entry(task, s, s_template, t, b_template,
+					sign_correction * sgn);
+		} else {			/* --- multiplication --- */
+			if (do_reduced != split_cycle) {
+				/* (-, -) --> (-) */
+				res |= put_d_entry(task, s, b_template + bs_mask,
+					t, s_template + s_mask, sgn);
+				/* (-, +) --> (+) */
+				if (do_odd) sign_correction =
+					((P_upto_born - P_upto_split) % 2) ?
+								-1 : 1;
+				res |= put_d_entry(task, s, b_template + s_mask,
+					t, s_template, sign_correction * sgn);
+			}
+
+			/* (+, -) --> (+) */
+			res |= put_d_entry(task, s, b_template + b_mask,
+					t, s_template, sgn);
+		}
+	}
+
+	return res;
+}
+
+/*
+ * Compute the matrices of the primary grading number k, going through all
+ * the (unenhanced) states with a given number of 1-smoothings in the same
+ * order as getDmatrices does.
+ */
+static int do_grading(long k)
+{
+	DmatrTask *task = grading_tasks + k;
+	unsigned long s_bits, t_bits, c, r;
+	unsigned long s_end = 1UL << num_crossings;
+	long i, sgn;
+
+	s_bits = (1UL << task->ones) - 1;
+	while (s_bits < s_end) {
+		for (i = 0; i < num_crossings; i++) {
+			if (s_bits & (1UL << i)) continue;
+			t_bits = s_bits | (1UL << i);
+
+			/* sign of the adjacency number */
+			if (do_odd)
+				sgn = ((GEN) edge_signs[i + 1])[s_bits + 1];
+			else
+				sgn = (__builtin_popcountl(s_bits >> (i + 1))
+							% 2) ? -1 : 1;
+
+			if (put_d_entries(task, s_bits + 1, t_bits + 1, sgn,
+				vec_entry(arrow_starts, i + 1)) == -1)
+				return -1;
+		}
+
+		/* the next bigger number with the same number of 1's */
+		if (s_bits == 0) break;
+		c = s_bits & -s_bits;
+		r = s_bits + c;
+		s_bits = (((r ^ s_bits) >> 2) / c) | r;
+	}
+
+	return 0;
+}
+
+/*
+ * Disjoint sets of elements 1, 2, ..., n (edges or sides of edges) that are
+ * joined into cycles. Members are:
+ *   number of elements,
+ *   parent of every element in the tree of its set (roots are their own),
+ *   upper bound for the height of every tree (for roots only),
+ *   number of the cycle of every root, used while numbering the cycles.
+ * All the arrays are of length n + 1.
+ */
+typedef struct cycle_sets {
+	long size;
+	long *parent, *rank, *label;
+} CycleSets;
+
+/*
+ * Allocate memory for sets of n elements. Return 0 on success and -1
+ * otherwise.
+ */
+static int init_sets(CycleSets *sets, long n)
+{
+	sets->size = n;
+	if ((sets->parent = (long *) malloc(3 * (n + 1) * sizeof(long)))
+			== NULL)
+		return -1;
+	sets->rank = sets->parent + (n + 1);
+	sets->label = sets->rank + (n + 1);
+
+	return 0;
+}
+
+/*
+ * Make every element a set of its own.
+ */
+static void reset_sets(CycleSets *sets)
+{
+	long e;
+
+	for (e = 1; e <= sets->size; e++) {
+		sets->parent[e] = e;
+		sets->rank[e] = 0;
+	}
+}
+
+/*
+ * Free the memory allocated for sets.
+ */
+static void kill_sets(CycleSets *sets)
+{
+	if (sets->parent != NULL) free(sets->parent);
+	sets->parent = sets->rank = sets->label = NULL;
+}
+
+/*
+ * Find the root of the tree an element belongs to, making all the elements
+ * on the way point to it directly.
+ */
+static inline long find_root(CycleSets *sets, long elem)
+{
+	long *parent = sets->parent, root = elem, next;
+
+	while (parent[root] != root) root = parent[root];
+	while (parent[elem] != root) {
+		next = parent[elem];
+		parent[elem] = root;
+		elem = next;
+	}
+
+	return root;
+}
+
+/*
+ * Join the sets of two elements, hanging the lower tree under the higher one.
+ */
+static inline void join_sets(CycleSets *sets, long elem1, long elem2)
+{
+	long root1 = find_root(sets, elem1), root2 = find_root(sets, elem2);
+
+	if (root1 == root2) return;
+
+	if (sets->rank[root1] < sets->rank[root2])
+		sets->parent[root1] = root2;
+	else {
+		sets->parent[root2] = root1;
+		if (sets->rank[root1] == sets->rank[root2]) sets->rank[root1]++;
+	}
+}
+
+/*
+ * Store the number of the cycle every element belongs to in incycle (from 1)
+ * and return the number of cycles. Cycles are numbered in the order of their
+ * smallest elements, as in list_cycles.
+ */
+static long number_sets(CycleSets *sets, long *incycle)
+{
+	long e, root, cycnum = 0;
+
+	for (e = 1; e <= sets->size; e++) sets->label[e] = 0;
+	for (e = 1; e <= sets->size; e++) {
+		root = find_root(sets, e);
+		if (sets->label[root] == 0) sets->label[root] = ++cycnum;
+		incycle[e] = sets->label[root];
+	}
+
+	return cycnum;
+}
+
+/*
+ * Find the cycles in the smoothing s of the diagram (numbered from 0). Store
+ * the number of the cycle every edge belongs to in incycle and return the
+ * number of cycles. sets must be of size num_edges.
+ */
+static long list_state_cycles(unsigned long s, GEN incycle, CycleSets *sets)
+{
+	long i, *edges;
+
+	reset_sets(sets);
+
+	/* the 0-smoothing joins edges 1, 2 and 3, 4 of a crossing and
+	 * the 1-smoothing joins edges 1, 4 and 3, 2 */
+	for (i = 0; i < num_crossings; i++) {
+		edges = xing_edges + 4 * i;
+		join_sets(sets, edges[0], edges[(s >> i) & 1 ? 3 : 1]);
+		join_sets(sets, edges[2], edges[(s >> i) & 1 ? 1 : 3]);
+	}
+
+	return number_sets(sets, incycle);
+}
+
+/*
+ * The same as j2matr in KhoHo_data.
+ */
+static inline long j2matr(long j)
+{
+	return (j_high - j) / 2 + 1;
+}
+
+/*
+ * Add mult times the number of enhanced states of a given number of cycles
+ * with every number of '-' to the lengths of the matrices of differentials
+ * of a primary grading, starting from the j-grading number j_matr. This is
+ * mult times adj_count[a, b] in list_generators.
+ */
+static void add_lengths(long *lengths, long mult, long cycnum, long j_matr)
+{
+	long k;
+
+	if (mult == 0 || cycnum < 0) return;
+
+	for (k = 0; k <= cycnum; k++)
+		if (j_matr + k >= 1 && j_matr + k <= j_size)
+			lengths[j_matr + k - 1] += mult * binomials[cycnum][k];
+}
+
+/*
+ * Find the cycles of all the states in the chunk number k, count the
+ * generators they give to every C^{i,j}(D), and the entries they add to
+ * the matrices of differentials. The same as the first half of the loop
+ * in list_generators.
+ */
+static int count_chunk(long k)
+{
+	StatesChunk *chunk = chunks + k;
+	unsigned long s;
+	CycleSets sets;
+	long *edges, *ranks, *lengths;
+	long i, ones, sigma_s, cycnum, n_free, j_matr;
+	long num_mult, num_comult, num_mult1, num_comult1, lcycle, rcycle;
+	GEN incycle;
+
+	if (init_sets(&sets, num_edges) == -1) {
+		set_error("list_states: not enough memory");
+		return -1;
+	}
+
+	for (s = chunk->first; s < chunk->last; s++) {
+		incycle = (GEN) ((GEN) states_info[s + 1])[3];
+		cycnum = list_state_cycles(s, incycle, &sets);
+		if (cycnum > MAX_CYCLES) {
+			set_error("list_states: too many cycles in a state");
+			kill_sets(&sets);
+			return -1;
+		}
+		state_cycnums[s] = cycnum;
+
+		ones = __builtin_popcountl(s);
+		sigma_s = num_crossings - 2 * ones;
+		ranks = chunk->ranks + ones * j_size;
+		lengths = chunk->lengths + ones * j_size;
+
+		/* generators: every '-' decreases j_matr by 1 */
+		n_free = cycnum - do_reduced;
+		j_matr = j2matr(- (sigma_s + 2 * cycnum - 3 * writhe_num) / 2);
+		if (j_matr - n_free < 1 || j_matr > j_size) {
+			set_error("list_states: wrong grading");
+			kill_sets(&sets);
+			return -1;
+		}
+		for (i = 0; i <= n_free; i++)
+			ranks[j_matr - i - 1] += binomials[n_free][i];
+
+		/* there are no differentials from the last primary grading */
+		if (ones == num_crossings) continue;
+
+		/* (co)multiplications possible at this state; those that
+		 * involve the 1st cycle are counted separately */
+		num_mult = num_comult = num_mult1 = num_comult1 = 0;
+		for (i = 0; i < num_crossings; i++) {
+			if ((s >> i) & 1) continue;
+
+			edges = xing_edges + 4 * i;
+			lcycle = incycle[edges[3]];
+			rcycle = incycle[edges[0]];
+			if (lcycle == rcycle) {
+				if (lcycle == 1) num_comult1++;
+				else num_comult++;
+			} else {
+				if (lcycle == 1 || rcycle == 1) num_mult1++;
+				else num_mult++;
+			}
+		}
+
+		/* see list_generators for how adjacent states are counted */
+		j_matr = j2matr(- (sigma_s - 3 * writhe_num +
+				2 * (- cycnum + 2 * do_reduced)) / 2);
+		if (do_reduced) {
+			add_lengths(lengths, num_mult1, cycnum - 2, j_matr);
+			add_lengths(lengths, num_comult1, cycnum - 1, j_matr);
+			add_lengths(lengths, num_mult, cycnum - 3, j_matr);
+			add_lengths(lengths, 2 * num_mult, cycnum - 3,
+								j_matr + 1);
+			add_lengths(lengths, 2 * num_comult, cycnum - 2,
+								j_matr);
+			add_lengths(lengths, num_comult, cycnum - 2,
+								j_matr + 1);
+		} else {
+			num_mult += num_mult1;
+			num_comult += num_comult1;
+			add_lengths(lengths, num_mult, cycnum - 2, j_matr);
+			add_lengths(lengths, 2 * num_mult, cycnum - 2,
+								j_matr + 1);
+			add_lengths(lengths, 2 * num_comult, cycnum - 1,
+								j_matr);
+			add_lengths(lengths, num_comult, cycnum - 1,
+								j_matr + 1);
+		}
+	}
+
+	kill_sets(&sets);
+	return 0;
+}
+
+/*
+ * Fill in the base edges of the cycles and number the enhanced states of all
+ * the states in the chunk number k, continuing from the numbers of generators
+ * in the chunks before it. The same as the second half of the loop in
+ * list_generators.
+ */
+static int number_chunk(long k)
+{
+	StatesChunk *chunk = chunks + k;
+	unsigned long s;
+	long e, ones, cycnum, S, j_matr, j_S_matr, *ranks;
+	GEN info, incycle, base_edges, en_states;
+
+	for (s = chunk->first; s < chunk->last; s++) {
+		info = (GEN) states_info[s + 1];
+		incycle = (GEN) info[3];
+		base_edges = (GEN) info[4];
+		en_states = (GEN) info[5];
+		cycnum = state_cycnums[s];
+
+		/* the smallest edge of every cycle */
+		for (e = 1; e <= cycnum; e++) base_edges[e] = 0;
+		for (e = 1; e <= num_edges; e++)
+			if (base_edges[incycle[e]] == 0)
+				base_edges[incycle[e]] = e;
+
+		ones = __builtin_popcountl(s);
+		ranks = chunk->ranks + ones * j_size;
+		j_matr = j2matr(- (num_crossings - 2 * ones +
+					2 * cycnum - 3 * writhe_num) / 2);
+
+		/* en_states_vec, packed tighter on a 64-bit architecture */
+		for (e = 1; e < lg(en_states); e++) en_states[e] = 0;
+		for (S = 0; S < (1L << cycnum); S += 1 + do_reduced) {
+			j_S_matr = j_matr - __builtin_popcountl(S);
+#ifdef LONG_IS_64BIT
+			en_states[S / 2 + 1] += (j_S_matr * JN_MASK +
+				++ranks[j_S_matr - 1]) * ((S % 2) ? ARCH64_MASK : 1);
+#else
+			en_states[S + 1] = j_S_matr * JN_MASK +
+						++ranks[j_S_matr - 1];
+#endif
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Apply a matrix of differentials in the packed format with n_rows rows and
+ * n_cols columns to vec_in and store the result in vec_out, modulo D2_PRIME.
+ * Both vectors are numbered from 1. Return 0 on success and -1 if some entry
+ * lies outside of the matrix.
+ */
+static int apply_d_matrix(GEN matr, long n_rows, long n_cols,
+		unsigned long *vec_in, unsigned long *vec_out)
+{
+	long k, row, col;
+	unsigned long value;
+
+	for (k = 1; k <= n_rows; k++) vec_out[k] = 0;
+
+#ifdef LONG_IS_64BIT
+	for (k = 1; k < lg(matr); k++) {
+		row = labs(matr[k]) / ARCH64_MASK;
+		col = labs(matr[k]) % ARCH64_MASK;
+		if (row < 1 || row > n_rows || col < 1 || col > n_cols)
+			return -1;
+		value = (matr[k] > 0) ? vec_in[col] : D2_PRIME - vec_in[col];
+#else
+	for (k = 1; k + 1 < lg(matr); k += 2) {
+		row = matr[k];
+		col = labs(matr[k + 1]);
+		if (row < 1 || row > n_rows || col < 1 || col > n_cols)
+			return -1;
+		value = (matr[k + 1] > 0) ?
+				vec_in[col] : D2_PRIME - vec_in[col];
+#endif
+		vec_out[row] = (vec_out[row] + value) % D2_PRIME;
+	}
+
+	return 0;
+}
+
+/*
+ * Check that d^2 = 0 for the task number k, that is, for the matrices
+ * d2_matrices[i][j] and d2_matrices[i + 1][j], where i = k / j_size + 1
+ * and j = k % j_size + 1. Store 1 in d2_failures[k] if d^2 is not 0 and
+ * 2 if some matrix entry is out of place.
+ */
+static int check_d2_pair(long k)
+{
+	long i = k / j_size + 1, j = k % j_size + 1, i_matr = d2_i_first + i - 1;
+	long rank0, rank1, rank2, l, t;
+	unsigned long *vec0, *vec1, *vec2;
+	uint64_t seed;
+	GEN matr1, matr2;
+
+	rank0 = itos((GEN) ((GEN) d2_ranks[i_matr])[j]);
+	rank1 = itos((GEN) ((GEN) d2_ranks[i_matr + 1])[j]);
+	rank2 = itos((GEN) ((GEN) d2_ranks[i_matr + 2])[j]);
+	if (rank0 == 0 || rank1 == 0 || rank2 == 0) return 0;
+
+	matr1 = (GEN) ((GEN) d2_matrices[i])[j];
+	matr2 = (GEN) ((GEN) d2_matrices[i + 1])[j];
+	if (typ(matr1) != t_VECSMALL || typ(matr2) != t_VECSMALL ||
+			lg(matr1) == 1 || lg(matr2) == 1)
+		return 0;
+
+	vec0 = (unsigned long *) malloc((rank0 + 1) * sizeof(unsigned long));
+	vec1 = (unsigned long *) malloc((rank1 + 1) * sizeof(unsigned long));
+	vec2 = (unsigned long *) malloc((rank2 + 1) * sizeof(unsigned long));
+	if (vec0 == NULL || vec1 == NULL || vec2 == NULL) {
+		set_error("check_d_squared: not enough memory");
+		if (vec0 != NULL) free(vec0);
+		if (vec1 != NULL) free(vec1);
+		if (vec2 != NULL) free(vec2);
+		return -1;
+	}
+
+	/* 64-bit xorshift (on every architecture), seeded by the task number
+	 * to be reproducible */
+	seed = UINT64_C(0x9E3779B97F4A7C15) * (uint64_t) (k + 1) + 1;
+	for (t = 0; t < D2_VECTORS && d2_failures[k] == 0; t++) {
+		for (l = 1; l <= rank0; l++) {
+			seed ^= seed << 13;
+			seed ^= seed >> 7;
+			seed ^= seed << 17;
+			vec0[l] = (unsigned long) (seed % D2_PRIME);
+		}
+
+		if (apply_d_matrix(matr1, rank1, rank0, vec0, vec1) == -1 ||
+			apply_d_matrix(matr2, rank2, rank1, vec1, vec2) == -1) {
+			d2_failures[k] = 2;
+			break;
+		}
+
+		for (l = 1; l <= rank2; l++)
+			if (vec2[l] != 0) {
+				d2_failures[k] = 1;
+				break;
+			}
+	}
+
+	free(vec0);
+	free(vec1);
+	free(vec2);
+	return 0;
+}
+
+/*
+ * Body of a thread: take the next task to do until none are left.
+ */
+static void *worker(void *arg)
+{
+	long k;
+
+	(void) arg;
+	for (;;) {
+		pthread_mutex_lock(&task_lock);
+		k = (err_message == NULL) ? next_task++ : num_tasks;
+		pthread_mutex_unlock(&task_lock);
+
+		if (k >= num_tasks || task_func(k) == -1) break;
+	}
+
+	return NULL;
+}
+
+/*
+ * Do n_tasks tasks with a given function in (at most) n_threads threads,
+ * one per processor if n_threads is 0 or less.
+ */
+static void run_tasks(long n_tasks, int (*func)(long), long n_threads)
+{
+	pthread_t threads[MAX_THREADS];
+	int is_started[MAX_THREADS];
+	long t;
+
+	task_func = func;
+	num_tasks = n_tasks;
+	next_task = 0;
+
+	if (n_threads <= 0) n_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (n_threads > n_tasks) n_threads = n_tasks;
+	if (n_threads > MAX_THREADS) n_threads = MAX_THREADS;
+
+	for (t = 0; t < n_threads; t++)
+		is_started[t] = (pthread_create(threads + t, NULL,
+						worker, NULL) == 0);
+	/* do the work here if no thread can be started at all */
+	if (n_threads > 0 && ! is_started[0]) worker(NULL);
+	for (t = 0; t < n_threads; t++)
+		if (is_started[t]) pthread_join(threads[t], NULL);
+}
+
+/*
+ * Free all the memory allocated in the process.
+ */
+static void cleanup(void)
+{
+	long k;
+
+	if (grading_tasks != NULL) {
+		for (k = 0; k < num_gradings; k++)
+			if (grading_tasks[k].lengths != NULL)
+				free(grading_tasks[k].lengths);
+		free(grading_tasks);
+	}
+
+	if (chunks != NULL) {
+		for (k = 0; k < num_chunks; k++) {
+			if (chunks[k].ranks != NULL) free(chunks[k].ranks);
+			if (chunks[k].lengths != NULL) free(chunks[k].lengths);
+		}
+		free(chunks);
+	}
+
+	if (xing_edges != NULL) free(xing_edges);
+	if (state_cycnums != NULL) free(state_cycnums);
+	if (d2_failures != NULL) free(d2_failures);
+
+	states_info = arrow_starts = edge_signs = NULL;
+	num_crossings = 0;
+	do_odd = do_reduced = 0;
+	j_size = 0;
+	grading_tasks = NULL;
+	num_gradings = 0;
+	xing_edges = NULL;
+	num_edges = writhe_num = j_high = 0;
+	state_cycnums = NULL;
+	chunks = NULL;
+	num_chunks = 0;
+	d2_matrices = d2_ranks = NULL;
+	d2_i_first = 0;
+	d2_failures = NULL;
+	task_func = NULL;
+	num_tasks = next_task = 0;
+	err_message = NULL;
+}
+
+/*
+ * Report an error (if any) after all the threads are done.
+ */
+static void check_error(void)
+{
+	char *error;
+
+	if ((error = err_message) != NULL) {
+		cleanup();
+		pari_err(talker, error);
+	}
+}
+
+/*
+ * Return the number of crossings in a matrix of crossings D (see init_diagr)
+ * or -1 if D is not such a matrix or some of its entries are not between
+ * 1 and max_entry.
+ */
+static long check_diagr(GEN D, long max_entry)
+{
+	long i, k, e, vnum;
+
+	if (typ(D) != t_MAT) return -1;
+	if (lg(D) == 1) return 0;
+	if (lg(D) != 5) return -1;
+
+	vnum = lg((GEN) D[1]) - 1;
+	for (k = 1; k <= 4; k++)
+		for (i = 1; i <= vnum; i++) {
+			e = itos((GEN) ((GEN) D[k])[i]);
+			if (e < 1 || (max_entry > 0 && e > max_entry)) return -1;
+		}
+
+	return vnum;
+}
+
+/*
+ * Entry (i, k) of a matrix of small integers.
+ */
+static inline long m_entry(GEN matr, long i, long k)
+{
+	return itos((GEN) ((GEN) matr[k])[i]);
+}
+
+/*
+ * Convert sets into the result of list_cycles: the number of cycles, the
+ * list of cycles every element belongs to, and the list of elements in every
+ * cycle (in increasing order).
+ */
+static GEN sets2pari(CycleSets *sets)
+{
+	GEN result, incycle, cycles, cycle;
+	long e, c, cycnum;
+
+	incycle = cgetg(sets->size + 1, t_VECSMALL);
+	cycnum = number_sets(sets, incycle);
+
+	/* label is free now: count the elements in every cycle there */
+	for (c = 1; c <= cycnum; c++) sets->label[c] = 0;
+	for (e = 1; e <= sets->size; e++) sets->label[incycle[e]]++;
+
+	cycles = cgetg(cycnum + 1, t_VEC);
+	for (c = 1; c <= cycnum; c++) {
+		cycles[c] = (long) cgetg(sets->label[c] + 1, t_VEC);
+		sets->label[c] = 0;
+	}
+	for (e = 1; e <= sets->size; e++) {
+		cycle = (GEN) cycles[incycle[e]];
+		cycle[++sets->label[incycle[e]]] = (long) stoi(e);
+	}
+
+	result = cgetg(4, t_VEC);
+	result[1] = (long) stoi(cycnum);
+	result[2] = (long) incycle;
+	result[3] = (long) cycles;
+
+	return result;
+}
+
+/*
+ * List cycles in a link diagram D after smoothing s. If s is not a vector
+ * and thus doesn't define a smoothing, list components of D instead.
+ * D may also be a vector [D, C], where rows of C are pairs of coupled edges.
+ * numtriv trivial components are added at the end.
+ *
+ * The result is the same as of list_cycles in KhoHo_chain: a vector with
+ * the number of cycles, the list of cycles where every edge belongs to, and
+ * the list of edges in every cycle.
+ */
+GEN list_cycles(GEN D, GEN s, long numtriv)
+{
+	GEN coupled = NULL, result;
+	CycleSets sets;
+	long vnum, n_elems, i, smoothing;
+
+	if (typ(D) == t_VEC) {
+		if (lg(D) < 3) pari_err(talker, "list_cycles: wrong diagram");
+		coupled = (GEN) D[2];
+		D = (GEN) D[1];
+	}
+
+	if ((vnum = check_diagr(D, 0)) == -1 || numtriv < 0)
+		pari_err(talker, "list_cycles: wrong diagram");
+	n_elems = 2 * vnum + numtriv;
+	if (check_diagr(D, n_elems) == -1 ||
+			(coupled != NULL && (typ(coupled) != t_MAT ||
+			(lg(coupled) > 1 && lg(coupled) != 3))))
+		pari_err(talker, "list_cycles: wrong diagram");
+	if (coupled != NULL && lg(coupled) > 1)
+		for (i = 1; i < lg((GEN) coupled[1]); i++)
+			if (m_entry(coupled, i, 1) < 1 ||
+					m_entry(coupled, i, 1) > n_elems ||
+					m_entry(coupled, i, 2) < 1 ||
+					m_entry(coupled, i, 2) > n_elems)
+				pari_err(talker, "list_cycles: wrong diagram");
+	if (typ(s) == t_VEC && lg(s) - 1 < vnum)
+		pari_err(talker, "list_cycles: wrong smoothing");
+
+	if (init_sets(&sets, n_elems) == -1)
+		pari_err(talker, "list_cycles: not enough memory");
+	reset_sets(&sets);
+
+	if (coupled != NULL && lg(coupled) > 1)
+		for (i = 1; i < lg((GEN) coupled[1]); i++)
+			join_sets(&sets, m_entry(coupled, i, 1),
+						m_entry(coupled, i, 2));
+
+	for (i = 1; i <= vnum; i++) {
+		if (typ(s) == t_VEC) {
+			/* list cycles according to the smoothing */
+			smoothing = vec_entry(s, i);
+			join_sets(&sets, m_entry(D, i, 1),
+					m_entry(D, i, smoothing ? 4 : 2));
+			join_sets(&sets, m_entry(D, i, 3),
+					m_entry(D, i, smoothing ? 2 : 4));
+		} else {
+			/* list cycles according to the diagram components */
+			join_sets(&sets, m_entry(D, i, 1), m_entry(D, i, 3));
+			join_sets(&sets, m_entry(D, i, 2), m_entry(D, i, 4));
+		}
+	}
+
+	result = sets2pari(&sets);
+	kill_sets(&sets);
+
+	return result;
+}
+
+/*
+ * List region boundaries for a link diagram D, Xsigns being the signs of
+ * all the crossings. The left and right sides of the edge i are numbered
+ * 2i-1 and 2i, respectively. The result is the same as of list_regions
+ * in KhoHo_sign, see list_cycles above.
+ */
+GEN list_regions(GEN D, GEN Xsigns)
+{
+	GEN result;
+	CycleSets sets;
+	long vnum, i;
+
+	if ((vnum = check_diagr(D, 0)) == -1 ||
+			check_diagr(D, 2 * vnum) == -1)
+		pari_err(talker, "list_regions: wrong diagram");
+	if (lg(Xsigns) - 1 < vnum)
+		pari_err(talker, "list_regions: wrong signs of crossings");
+
+	if (init_sets(&sets, 4 * vnum) == -1)
+		pari_err(talker, "list_regions: not enough memory");
+	reset_sets(&sets);
+
+	/* at every crossing connect pieces of boundary
+	 * corresponding to 4 regions adjacent to the crossing */
+	for (i = 1; i <= vnum; i++) {
+		if (vec_entry(Xsigns, i) == 1) {
+			/* positive crossing */
+			join_sets(&sets, 2 * m_entry(D, i, 1),
+						2 * m_entry(D, i, 2));
+			join_sets(&sets, 2 * m_entry(D, i, 2) - 1,
+						2 * m_entry(D, i, 3));
+			join_sets(&sets, 2 * m_entry(D, i, 3) - 1,
+						2 * m_entry(D, i, 4) - 1);
+			join_sets(&sets, 2 * m_entry(D, i, 4),
+						2 * m_entry(D, i, 1) - 1);
+		} else {
+			/* negative crossing */
+			join_sets(&sets, 2 * m_entry(D, i, 1),
+						2 * m_entry(D, i, 2) - 1);
+			join_sets(&sets, 2 * m_entry(D, i, 2),
+						2 * m_entry(D, i, 3));
+			join_sets(&sets, 2 * m_entry(D, i, 3) - 1,
+						2 * m_entry(D, i, 4));
+			join_sets(&sets, 2 * m_entry(D, i, 4) - 1,
+						2 * m_entry(D, i, 1) - 1);
+		}
+	}
+
+	result = sets2pari(&sets);
+	kill_sets(&sets);
+
+	return result;
+}
+
+/*
+ * List the generators of the chain complex of a link diagram given by
+ * a matrix D of crossings (see list_generators), splitting the states into
+ * chunks done in parallel. First, the cycles of every state are found and
+ * the generators in every chunk are counted; then the generators are numbered
+ * in every chunk starting from the numbers of those in the chunks before it,
+ * so that the result is exactly the same as in list_generators (without the
+ * Morse matching, which is not supported).
+ *
+ * Arguments are:
+ *   matrix of crossings D and the number of trivial components
+ *   writhe, j_high and j_size of the diagram
+ *   whether the homology is reduced
+ *   number of threads to use (0 or less for one per processor)
+ *
+ * The return value is a vector with states_info[datapos], the ranks of
+ * the chain groups as a j_size x i_size matrix (as in chain_ranks, but without
+ * the gradings), and allmatr_length[datapos].
+ */
+GEN list_states(GEN D, long numtriv, long writhe, long jhigh, long jsize,
+		long reduced, long n_threads)
+{
+	unsigned long s, num_states, chunk_size;
+	long i, j, k, e, i_size, cycnum, *running;
+	GEN result, info, ranks, lengths;
+
+	if (typ(D) != t_MAT || lg(D) != 5)
+		pari_err(talker, "list_states: wrong diagram");
+	num_crossings = lg((GEN) D[1]) - 1;
+	if (num_crossings < 1 || num_crossings >= 8 * (long) sizeof(long) - 1
+			|| numtriv < 0 || jsize < 1) {
+		cleanup();
+		pari_err(talker, "list_states: wrong arguments");
+	}
+
+	num_edges = 2 * num_crossings + numtriv;
+	writhe_num = writhe;
+	j_high = jhigh;
+	j_size = jsize;
+	do_reduced = (reduced != 0);
+	i_size = num_crossings + 1;
+	num_states = 1UL << num_crossings;
+
+	for (i = 0; i <= MAX_CYCLES; i++)
+		for (k = 0; k <= i; k++)
+			binomials[i][k] = (k == 0 || k == i) ? 1 :
+				binomials[i - 1][k - 1] + binomials[i - 1][k];
+
+	if (n_threads <= 0) n_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (n_threads < 1) n_threads = 1;
+	chunk_size = num_states / (CHUNKS_PER_THREAD * n_threads) + 1;
+	num_chunks = (num_states + chunk_size - 1) / chunk_size;
+
+	xing_edges = (long *) malloc(4 * num_crossings * sizeof(long));
+	state_cycnums = (int *) malloc(num_states * sizeof(int));
+	chunks = (StatesChunk *) calloc(num_chunks, sizeof(StatesChunk));
+	if (xing_edges == NULL || state_cycnums == NULL || chunks == NULL) {
+		cleanup();
+		pari_err(talker, "list_states: not enough memory");
+	}
+
+	for (i = 0; i < num_crossings; i++)
+		for (k = 0; k < 4; k++) {
+			e = itos((GEN) ((GEN) D[k + 1])[i + 1]);
+			if (e < 1 || e > num_edges) {
+				cleanup();
+				pari_err(talker, "list_states: wrong diagram");
+			}
+			xing_edges[4 * i + k] = e;
+		}
+
+	for (k = 0; k < num_chunks; k++) {
+		chunks[k].first = k * chunk_size;
+		chunks[k].last = (k + 1) * chunk_size;
+		if (chunks[k].last > num_states) chunks[k].last = num_states;
+		chunks[k].ranks = (long *) calloc(i_size * j_size, sizeof(long));
+		chunks[k].lengths =
+			(long *) calloc(i_size * j_size, sizeof(long));
+		if (chunks[k].ranks == NULL || chunks[k].lengths == NULL) {
+			cleanup();
+			pari_err(talker, "list_states: not enough memory");
+		}
+	}
+
+	/* the threads never touch PARI: whatever size is known is allocated
+	 * in advance, and the rest once the cycles are found */
+	states_info = cgetg(num_states + 1, t_VEC);
+	for (s = 0; s < num_states; s++) {
+		info = cgetg(6, t_VEC);
+		info[3] = (long) cgetg(num_edges + 1, t_VECSMALL);
+		states_info[s + 1] = (long) info;
+	}
+
+	run_tasks(num_chunks, count_chunk, n_threads);
+	check_error();
+
+	for (s = 0; s < num_states; s++) {
+		info = (GEN) states_info[s + 1];
+		cycnum = state_cycnums[s];
+
+		info[1] = (long) stoi(__builtin_popcountl(s) + 1);
+		info[2] = (long) stoi(cycnum);
+		info[4] = (long) cgetg(cycnum + 1, t_VECSMALL);
+#ifdef LONG_IS_64BIT
+		info[5] = (long) cgetg((1L << (cycnum - 1)) + 1, t_VECSMALL);
+#else
+		info[5] = (long) cgetg((1L << cycnum) + 1, t_VECSMALL);
+#endif
+	}
+
+	/* lengths of the matrices of all the chunks are collected in
+	 * the first one */
+	running = chunks[0].lengths;
+	for (k = 1; k < num_chunks; k++)
+		for (i = 0; i < i_size * j_size; i++)
+			running[i] += chunks[k].lengths[i];
+	lengths = cgetg(j_size + 1, t_MAT);
+	for (j = 1; j <= j_size; j++) {
+		lengths[j] = (long) cgetg(i_size, t_COL);
+		for (i = 1; i < i_size; i++)
+			((GEN) lengths[j])[i] =
+				(long) stoi(running[(i - 1) * j_size + j - 1]);
+	}
+
+	/* numbers of generators before every chunk (and in all of them) */
+	for (i = 0; i < i_size * j_size; i++) running[i] = 0;
+	for (k = 0; k < num_chunks; k++)
+		for (i = 0; i < i_size * j_size; i++) {
+			e = chunks[k].ranks[i];
+			chunks[k].ranks[i] = running[i];
+			running[i] += e;
+			if (running[i] >= JN_MASK) {
+				cleanup();
+				pari_err(talker, "list_states: number of "
+					"generators is too large");
+			}
+		}
+	ranks = cgetg(i_size + 1, t_MAT);
+	for (i = 1; i <= i_size; i++) {
+		ranks[i] = (long) cgetg(j_size + 1, t_COL);
+		for (j = 1; j <= j_size; j++)
+			((GEN) ranks[i])[j] =
+				(long) stoi(running[(i - 1) * j_size + j - 1]);
+	}
+
+	run_tasks(num_chunks, number_chunk, n_threads);
+	check_error();
+
+	result = cgetg(4, t_VEC);
+	result[1] = (long) states_info;
+	result[2] = (long) ranks;
+	result[3] = (long) lengths;
+
+	cleanup();
+	return result;
+}
+
+/*
+ * Compute the matrices of chain differentials for several primary gradings
+ * at once, one grading per thread. This is the same as calling getDmatrices
+ * for each of them, except for the Morse matching, which is not supported.
+ *
+ * Arguments are:
+ *   states_info[datapos] (see list_generators)
+ *   edges where the arrows representing resolution orientations start
+ *   edge_signs for odd homology (anything otherwise)
+ *   numbers of 1-smoothings in the states of the primary gradings needed
+ *   for every such grading, lengths of the matrices (allmatr_length)
+ *   number of crossings
+ *   whether the homology is odd and whether it's reduced
+ *   number of threads to use (0 or less for one per processor)
+ *
+ * The return value is a vector with the matrices of every primary grading
+ * given, in the same format as diff_matrices. The matrices are allocated
+ * in advance from the lengths given, so the threads never touch PARI.
+ */
+GEN get_d_matrices(GEN states, GEN astart, GEN signs, GEN ones, GEN lengths,
+		long vnum, long odd, long reduced, long n_threads)
+{
+	long k, j, words = 2 - (sizeof(long) > 4);
+	GEN result, task_lengths;
+
+	if (vnum < 1 || vnum >= 8 * (long) sizeof(long) - 1)
+		pari_err(talker, "get_d_matrices: wrong number of crossings");
+
+	states_info = states;
+	arrow_starts = astart;
+	edge_signs = signs;
+	num_crossings = vnum;
+	do_odd = (odd != 0);
+	do_reduced = (reduced != 0);
+
+	num_gradings = lg(ones) - 1;
+	result = cgetg(num_gradings + 1, t_VEC);
+	if ((grading_tasks = (DmatrTask *) calloc(num_gradings + 1,
+					sizeof(DmatrTask))) == NULL) {
+		cleanup();
+		pari_err(talker, "get_d_matrices: not enough memory");
+	}
+
+	for (k = 0; k < num_gradings; k++) {
+		grading_tasks[k].ones = itos((GEN) ones[k + 1]);
+		task_lengths = (GEN) lengths[k + 1];
+		j_size = lg(task_lengths) - 1;
+
+		grading_tasks[k].matrices = cgetg(j_size + 1, t_VEC);
+		for (j = 1; j <= j_size; j++)
+			grading_tasks[k].matrices[j] = (long) cgetg(words *
+				vec_entry(task_lengths, j) + 1, t_VECSMALL);
+		result[k + 1] = (long) grading_tasks[k].matrices;
+
+		grading_tasks[k].lengths =
+			(long *) calloc(j_size + 1, sizeof(long));
+		if (grading_tasks[k].lengths == NULL ||
+				grading_tasks[k].ones < 0 ||
+				grading_tasks[k].ones > vnum) {
+			cleanup();
+			pari_err(talker, "get_d_matrices: wrong arguments");
+		}
+	}
+
+	run_tasks(num_gradings, do_grading, n_threads);
+
+	/* all the matrices have to be filled up to the end */
+	for (k = 0; k < num_gradings && err_message == NULL; k++)
+		for (j = 1; j <= j_size; j++)
+			if (words * grading_tasks[k].lengths[j - 1] !=
+				lg((GEN) grading_tasks[k].matrices[j]) - 1)
+				err_message =
+				    "get_d_matrices: wrong length of a matrix";
+	check_error();
+
+	cleanup();
+	return result;
+}
+
+/*
+ * Check that d^2 = 0 for the matrices of differentials of several
+ * consecutive primary gradings, all the secondary gradings in parallel.
+ * d^2 is applied to D2_VECTORS random vectors modulo D2_PRIME.
+ *
+ * Arguments are:
+ *   vector of the matrices of every primary grading, in the same format as
+ *   diff_matrices (that is, rows of allmatr[datapos])
+ *   chain_ranks[datapos]
+ *   i_matr of the first primary grading given
+ *   number of threads to use (0 or less for one per processor)
+ *
+ * The return value is a vector of [i_matr, j_matr, what] for every pair of
+ * matrices that fails the check, where what is 1 if their product is not 0
+ * and 2 if some entry lies outside of its matrix.
+ */
+GEN check_d_squared(GEN matrices, GEN ranks, long i_first, long n_threads)
+{
+	long k, n_failures, n_gradings = lg(matrices) - 1;
+	GEN result, failure;
+
+	if (n_gradings < 2) return cgetg(1, t_VEC);
+
+	d2_matrices = matrices;
+	d2_ranks = ranks;
+	d2_i_first = i_first;
+	j_size = lg((GEN) matrices[1]) - 1;
+	if (i_first < 1 || i_first + n_gradings > lg(ranks) - 1) {
+		cleanup();
+		pari_err(talker, "check_d_squared: wrong primary gradings");
+	}
+	for (k = 1; k <= n_gradings; k++)
+		if (lg((GEN) matrices[k]) - 1 != j_size ||
+				lg((GEN) ranks[i_first + k - 1]) - 1 < j_size) {
+			cleanup();
+			pari_err(talker,
+				"check_d_squared: wrong secondary gradings");
+		}
+
+	if ((d2_failures = (char *) calloc((n_gradings - 1) * j_size,
+					sizeof(char))) == NULL) {
+		cleanup();
+		pari_err(talker, "check_d_squared: not enough memory");
+	}
+
+	run_tasks((n_gradings - 1) * j_size, check_d2_pair, n_threads);
+	check_error();
+
+	for (k = 0, n_failures = 0; k < (n_gradings - 1) * j_size; k++)
+		if (d2_failures[k] != 0) n_failures++;
+	result = cgetg(n_failures + 1, t_VEC);
+	for (k = 0, n_failures = 0; k < (n_gradings - 1) * j_size; k++)
+		if (d2_failures[k] != 0) {
+			failure = cgetg(4, t_VECSMALL);
+			failure[1] = i_first + k / j_size;
+			failure[2] = k % j_size + 1;
+			failure[3] = d2_failures[k];
+			result[++n_failures] = (long) failure;
+		}
+
+	cleanup();
+	return result;
+}
@@ -0,0 +1,479 @@
+/*
+ *    sparfilt.c --- reduce a filtered chain complex over a field (Z/p) to
+ *                   nothing, cancelling pairs of generators in the order of
+ *                   their filtration jumps, so that the generators that
+ *                   survive give the associated graded homology together
+ *                   with the filtration levels.
+ *                   Matrices of differentials are presented in the
+ *                   PARI/GP implementation of a sparse format, and all
+ *                   computations are done using sparmat library.
+ *
+ * Copyright (C) 2002--2018 Alexander Shumakovitch <Shurik@gwu.edu>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see COPYING.gz. If not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *
+ * To load from PARI/GP:
+ *    install(filter_s_complex, "LGGGGD0,L,", filter_s_complex,
+ *							"./sparfilt.so")
+ */
+
+#include <stdlib.h>
+#include <limits.h>
+#include <pari/pari.h>
+
+#if PARI_VERSION_CODE > PARI_VERSION(2,7,0)
+#  define talker e_MISC
+#endif
+
+/* entries are residues modulo a prime chosen at run time, see sparmat.h */
+#define SM_RING_MODP
+#define SM_PRIME_RUNTIME
+#include "sparmat.h"
+
+/* print some reduction statistic */
+// #define PRINT_REDSTAT
+
+#define ERR_BAIL(msg) { ERR_MESSAGE = (msg); bailout(); }
+
+/*
+ * Type for complex sizes. 4 bytes (i.e. up to 2^32) is enough.
+ */
+typedef int SM_complex_t;
+
+static SM_complex_t cplx_size = 0;		// size of the chain complex
+static SparseMatrix *cplx_matrices = NULL;	// matrices of differentials
+static SM_index_t *cplx_group_ranks = NULL;	// ranks of the chain groups
+static char **gen_killed = NULL;		// whether a generator is gone
+static GEN gen_levels = NULL;			// levels of the generators
+
+static SM_index_t *row_indices = NULL;		// copy of the pivot row
+static SM_value_t *row_values = NULL;
+static SM_index_t row_length = 0;		// room in the arrays above
+
+/*
+ * Free all the memory allocated in the process.
+ */
+static void cleanup(void)
+{
+	SM_complex_t i;
+
+	if (cplx_matrices != NULL) {
+		for (i = 0; i < cplx_size - 1; i++)
+			kill_s_matrix(cplx_matrices + i);
+		free(cplx_matrices);
+	}
+
+	if (gen_killed != NULL) {
+		for (i = 0; i < cplx_size; i++)
+			if (gen_killed[i] != NULL) free(gen_killed[i]);
+		free(gen_killed);
+	}
+
+	if (cplx_group_ranks != NULL) free(cplx_group_ranks);
+	if (row_indices != NULL) free(row_indices);
+	if (row_values != NULL) free(row_values);
+
+	cplx_size = 0;
+	cplx_matrices = NULL;
+	cplx_group_ranks = NULL;
+	gen_killed = NULL;
+	gen_levels = NULL;
+	row_indices = NULL;
+	row_values = NULL;
+	row_length = 0;
+}
+
+/*
+ * Bailout on error.
+ */
+static void bailout(void)
+{
+	cleanup();
+	pari_err(talker, ERR_MESSAGE);
+}
+
+/*
+ * Allocate memory for main arrays and assign the ranks of the chain groups.
+ */
+static void malloc_arrays(SM_complex_t c_size, GEN c_ranks)
+{
+	SM_complex_t i;
+	char *mem_error = "malloc_arrays: not enough memory";
+
+	cplx_size = c_size;
+
+	cplx_matrices = (SparseMatrix *)
+				malloc((cplx_size - 1) * sizeof(SparseMatrix));
+	if (cplx_matrices == NULL) ERR_BAIL(mem_error)
+
+	for (i = 0; i < cplx_size - 1; i++) {
+		cplx_matrices[i].num_rows = 0;
+		cplx_matrices[i].num_cols = 0;
+		cplx_matrices[i].rows = NULL;
+		cplx_matrices[i].columns = NULL;
+		cplx_matrices[i].rows_only = 0;
+	}
+
+	gen_killed = (char **) calloc(cplx_size, sizeof(char *));
+	cplx_group_ranks = (SM_index_t *) malloc(cplx_size * sizeof(SM_index_t));
+	if (gen_killed == NULL || cplx_group_ranks == NULL) ERR_BAIL(mem_error)
+
+	for (i = 0; i < cplx_size; i++) {
+		cplx_group_ranks[i] = (SM_index_t) itos((GEN) c_ranks[i + 1]);
+
+		/* generators are numbered from 1 */
+		gen_killed[i] = (char *) calloc(cplx_group_ranks[i] + 1, 1);
+		if (gen_killed[i] == NULL) ERR_BAIL(mem_error)
+	}
+}
+
+/*
+ * Filtration level of a generator gen_num in the group.
+ */
+static inline long gen_level(SM_complex_t group, SM_index_t gen_num)
+{
+	return ((GEN) gen_levels[group + 1])[gen_num];
+}
+
+/*
+ * Add an entry to a matrix being assigned, unless its value is zero modulo
+ * the prime (or there is no entry, that is, row is 0). Count the entries
+ * added in *n_entries.
+ */
+static void add_summed_entry(SparseMatrix *matr, SM_index_t row,
+		SM_index_t column, SM_value_t value, long *n_entries)
+{
+	if (row == 0 || is_val_zero(reduce_val(value))) return;
+
+	if (add_m_entry(matr, row, column, value) == -1) bailout();
+	(*n_entries)++;
+}
+
+/*
+ * Given a matrix in PARI's sparse format, translate it into the internal one.
+ * The format is the packed one of sparreduce.c:
+ *   on a 64-bit architecture the entry is value * (row * 2^32 + column)
+ *   with value = \pm1
+ *   on a 32-bit architecture every matrix entry occupies 2 places
+ *   in the VECSMALL vector: ..., row, value * column, ...
+ *   row and column are assumed to be not bigger than 2^31
+ * An entry can be repeated right after itself, in which case the values are
+ * summed up (as in sparreduce.c). Any other repetition is an error.
+ */
+static void assign_matrix(SparseMatrix *matr, GEN entries_list, long list_len)
+{
+	GEN GEN_ptr = entries_list + 1;
+	long i;
+#ifdef LONG_IS_64BIT
+	long tmp_val;
+#endif
+	SM_index_t row, column, prev_row = 0, prev_column = 0;
+	SM_value_t prev_value = 0;
+	long n_entries = 0;
+	int is_val_neg;
+
+	if (typ(entries_list) != t_VECSMALL)
+		ERR_BAIL("assign_matrix: input matrix is not packed")
+
+	for (i = 0; i < list_len; i++, GEN_ptr++) {
+#ifdef LONG_IS_64BIT
+		tmp_val = (long) *GEN_ptr;
+		is_val_neg = tmp_val < 0;
+		tmp_val = labs(tmp_val);
+
+		row = tmp_val >> 32;
+		column = tmp_val & ((1L << 32) - 1);
+#else
+		row = (SM_index_t) *(GEN_ptr++);
+		column = (SM_index_t) *GEN_ptr;
+		is_val_neg = column < 0;
+
+		column = abs(column);
+#endif
+		if (row == prev_row && column == prev_column) {
+			prev_value += is_val_neg ? -1 : 1;
+			continue;
+		}
+
+		add_summed_entry(matr, prev_row, prev_column, prev_value,
+								&n_entries);
+		prev_row = row;
+		prev_column = column;
+		prev_value = is_val_neg ? -1 : 1;
+	}
+	add_summed_entry(matr, prev_row, prev_column, prev_value, &n_entries);
+
+	/* add_m_entry replaces an entry that is there already */
+	if (count_m_entries(matr, NULL, NULL) != n_entries)
+		ERR_BAIL("assign_matrix: an entry is repeated")
+}
+
+/*
+ * Initialize the differential matrices and check that they respect the
+ * filtration, that is, never decrease the filtration level.
+ * Return the largest filtration jump that can ever occur.
+ */
+static long init_matrices(GEN d_matrices, GEN matr_lengths)
+{
+	SM_complex_t i;
+	SM_index_t gen, j;
+	long level, min_level = LONG_MAX, max_level = LONG_MIN;
+	SparseVector *row;
+
+	for (i = 0; i < cplx_size; i++)
+		for (gen = 1; gen <= cplx_group_ranks[i]; gen++) {
+			level = gen_level(i, gen);
+			if (level < min_level) min_level = level;
+			if (level > max_level) max_level = level;
+		}
+
+	for (i = 0; i < cplx_size - 1; i++) {
+		/* only matrices between non-empty groups are interesting */
+		if (cplx_group_ranks[i] == 0 || cplx_group_ranks[i + 1] == 0)
+			continue;
+
+		if (init_s_matrix(cplx_matrices + i, cplx_group_ranks[i + 1],
+					cplx_group_ranks[i]) == -1) bailout();
+		assign_matrix(cplx_matrices + i, (GEN) d_matrices[i + 1],
+					itos((GEN) matr_lengths[i + 1]));
+
+		row = cplx_matrices[i].rows;
+		for (gen = 1; gen <= cplx_group_ranks[i + 1]; gen++, row++)
+			for (j = 0; j < row->num_entries; j++)
+				if (gen_level(i + 1, gen) <
+					gen_level(i, row->indices[j]))
+		ERR_BAIL("filter_s_complex: differential lowers the filtration")
+	}
+
+	return (max_level < min_level) ? 0 : max_level - min_level;
+}
+
+/*
+ * Kill a generator gen_num in the group.
+ */
+static void kill_gen(SM_complex_t group, SM_index_t gen_num)
+{
+	/* matrices next to empty groups are never initialized */
+	if (group > 0 && cplx_matrices[group - 1].rows != NULL)
+		if (erase_m_row(cplx_matrices + group - 1, gen_num, 1) == -1)
+			bailout();
+
+	if (group < cplx_size - 1 && cplx_matrices[group].rows != NULL)
+		if (erase_m_column(cplx_matrices + group, gen_num, 1) == -1)
+			bailout();
+
+	gen_killed[group][gen_num] = 1;
+}
+
+/*
+ * Copy the entries of a row into row_indices and row_values.
+ */
+static void copy_row(SparseVector *row)
+{
+	SM_index_t i;
+
+	if (row->num_entries > row_length) {
+		if (row_indices != NULL) free(row_indices);
+		if (row_values != NULL) free(row_values);
+
+		row_length = 2 * row->num_entries;
+		row_indices = (SM_index_t *)
+				malloc(row_length * sizeof(SM_index_t));
+		row_values = (SM_value_t *)
+				malloc(row_length * sizeof(SM_value_t));
+		if (row_indices == NULL || row_values == NULL)
+			ERR_BAIL("copy_row: not enough memory")
+	}
+
+	for (i = 0; i < row->num_entries; i++) {
+		row_indices[i] = row->indices[i];
+		row_values[i] = get_v_value(row, i);
+	}
+}
+
+/*
+ * Cancel generators in a given group against the ones in the previous group
+ * along the entries of the differential that raise the filtration level by
+ * exactly jump. Of all such entries in a row, the one with the shortest
+ * column is used, so that the matrix stays as sparse as possible.
+ * Return 1 if some cancellation was done and 0 otherwise.
+ *
+ * Since all the entries with smaller jumps are gone by now, the column
+ * operations below never add a generator of a lower level to the one of a
+ * higher level, so the new bases stay filtered, and the entries they create
+ * raise the filtration by at least jump.
+ */
+static int cancel_gens(SM_complex_t group, long jump)
+{
+	SM_index_t elim_cnt = 0, gen, inc_gen, col_len, i, n_inc;
+	SM_value_t gen_coeff;
+	int isfound = 0;
+
+	SparseMatrix *matr = cplx_matrices + group - 1;
+	SparseVector *inum_vectors;
+	char *gen_error = "cancel_gens: generator is not killed cleanly";
+
+	/* nothing to cancel if either group is empty */
+	if (matr->rows == NULL) return 0;
+
+	inum_vectors = matr->rows;
+
+	for (gen = 1; gen <= cplx_group_ranks[group]; gen++, inum_vectors++) {
+		if (inum_vectors->num_entries <= 0) continue; // gone or cycle
+
+		inc_gen = 0;
+		col_len = 0;
+		for (i = 0; i < inum_vectors->num_entries; i++) {
+			if (gen_level(group, gen) - gen_level(group - 1,
+				inum_vectors->indices[i]) != jump) continue;
+			if (inc_gen == 0 || col_len > matr->columns
+				[inum_vectors->indices[i] - 1].num_entries) {
+				inc_gen = inum_vectors->indices[i];
+				gen_coeff = get_v_value(inum_vectors, i);
+				col_len = matr->columns[inc_gen - 1].
+								num_entries;
+			}
+		}
+
+		if (inc_gen == 0) continue; // no entries with this jump
+
+		/* every non-zero residue is invertible and we need to use
+		 * the inverse for subtraction */
+		gen_coeff = neg_val(inv_val(gen_coeff));
+
+		/* entries in this row are being erased as the elimination
+		 * is taking place, so we need to copy them first */
+		copy_row(inum_vectors);
+		n_inc = inum_vectors->num_entries;
+
+		for (i = 0; i < n_inc; i++) {
+			if (row_indices[i] == inc_gen) continue;
+
+			if (add_m_cols(matr, row_indices[i], inc_gen,
+				mult_vals(row_values[i], gen_coeff)) < 0)
+					bailout();
+		}
+
+		elim_cnt++;
+		isfound = 1;
+
+		/* a single entry should remain in this column by now ... */
+		if (inum_vectors->num_entries != 1) ERR_BAIL(gen_error);
+		kill_gen(group - 1, inc_gen);
+
+		/* ... and now it has to be gone too */
+		if (inum_vectors->num_entries != 0) ERR_BAIL(gen_error);
+		kill_gen(group, gen);
+	}
+
+#ifdef PRINT_REDSTAT
+	if (isfound) printf("%d | ", elim_cnt);
+#endif
+
+	return isfound;
+}
+
+/*
+ * Cancel all the generators that can be cancelled, that is, make all the
+ * differentials zero. This is done in the increasing order of jumps, since
+ * cancelling along a jump J can only create entries with jumps J or more.
+ */
+static void reduce_filtered(long max_jump)
+{
+	SM_complex_t group;
+	long jump;
+	int isfound;
+
+	for (jump = 0; jump <= max_jump; jump++) {
+#ifdef PRINT_REDSTAT
+		printf("\n  jump %ld: ", jump);
+#endif
+		do {
+			isfound = 0;
+			for (group = 1; group < cplx_size; group++)
+				while (cancel_gens(group, jump)) isfound = 1;
+		} while (isfound);
+	}
+
+	for (group = 0; group < cplx_size - 1; group++)
+		if (cplx_matrices[group].rows != NULL &&
+				count_m_entries(cplx_matrices + group,
+							NULL, NULL) != 0)
+		ERR_BAIL("reduce_filtered: differentials are not killed");
+}
+
+/*
+ * Prepare the result to be sent back to PARI.
+ */
+static GEN feed2pari(void)
+{
+	SM_complex_t group;
+	SM_index_t gen, n_gens;
+	GEN main_vec = cgetg(cplx_size + 1, t_VEC);
+	GEN levels_vec;
+
+	for (group = 0; group < cplx_size; group++) {
+		n_gens = 0;
+		for (gen = 1; gen <= cplx_group_ranks[group]; gen++)
+			if (! gen_killed[group][gen]) n_gens++;
+
+		levels_vec = cgetg(n_gens + 1, t_VECSMALL);
+		for (gen = 1, n_gens = 0; gen <= cplx_group_ranks[group]; gen++)
+			if (! gen_killed[group][gen])
+				levels_vec[++n_gens] = gen_level(group, gen);
+
+		main_vec[group + 1] = (long) levels_vec;
+	}
+
+	return main_vec;
+}
+
+/*
+ * Compute the associated graded homology of a filtered chain complex over
+ * Z/p by cancelling all the differentials in the order of filtration jumps.
+ *
+ * Arguments are:
+ *   size (length) of the complex
+ *   ranks of the chain groups
+ *   filtration levels of the generators, one VECSMALL for every group
+ *   matrices of chain differentials in the sparse format
+ *   lengths of arrays representing the matrices
+ *   the prime p (p = 2^31 - 1 if 0)
+ *
+ * The return value is a vector of VECSMALLs with the filtration levels of
+ * the generators that survived, one for every group.
+ */
+GEN filter_s_complex(long c_size, GEN c_ranks, GEN c_levels, GEN d_matrices,
+					GEN matr_lengths, long prime)
+{
+	GEN answer;
+	long max_jump;
+
+	if (prime < 0 || prime >= (1L << 31))
+		pari_err(talker, "filter_s_complex: the prime is out of range");
+	sm_prime = (prime == 0) ? 2147483647L : prime;
+
+	malloc_arrays((SM_complex_t) c_size, c_ranks);
+	gen_levels = c_levels;
+
+	max_jump = init_matrices(d_matrices, matr_lengths);
+	reduce_filtered(max_jump);
+
+	answer = feed2pari();
+
+	cleanup();
+	return answer;
+}
@@ -1,5 +1,8 @@
 /*
  *    sparmat.c --- computation library for working with sparse matrices.
+ *                  The ring of entries is chosen at compile time, see
+ *                  sparmat.h. sparmat-U.o is this file compiled with
+ *                  SM_RING_U defined.
  *
  * Copyright (C) 2002--2018 Alexander Shumakovitch <Shurik@gwu.edu>
  *
@@ -21,52 +24,209 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <limits.h>
 
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#  include <immintrin.h>
+#endif
+
 #include "sparmat.h"
 
 /* perform some consistency tests */
 #define SPARMAT_DEBUG
 
-char *ERR_MESSAGE;
+__thread char *ERR_MESSAGE;
+
+#ifdef SM_PRIME_RUNTIME
+long sm_prime = 2147483647L;
+#endif
 #define ERR_RET(msg, val) { ERR_MESSAGE = (msg); return (val); }
 #define ERRET_1(msg) ERR_RET((msg), -1)
 #define ERRET_M(msg) ERR_RET((msg), ERR_MVAL)
 
 /*
- * Return the entry's value from a sparse vector (or 0 if there is none).
+ * Check whether a value returned is ERR_MVAL (that is, an error occurred).
  */
-static SM_value_t get_v_entry(SparseVector *vec, SM_index_t ind)
+#define IS_ERR_MVAL(val) are_vals_equal((val), ERR_MVAL)
+
+/*
+ * Return the narrowest width (in bytes) all the coefficients of a value
+ * can be stored with.
+ */
+static inline int value_width(SM_value_t val)
 {
-	SparseEntry *eptr;
+	SM_coeff_t coeff;
+	int k, width = 1;
+
+	for (k = 0; k < SM_NCOMP; k++) {
+		coeff = SM_COMP(val, k);
+		if (coeff >= INT8_MIN && coeff <= INT8_MAX) continue;
+		if (coeff >= INT16_MIN && coeff <= INT16_MAX) {
+			if (width < 2) width = 2;
+			continue;
+		}
+		if (coeff >= INT32_MIN && coeff <= INT32_MAX) {
+			if (width < 4) width = 4;
+			continue;
+		}
 
-	/* find the desired entry (if it exists) */
-	for (eptr = vec->entries; eptr != NULL; eptr = eptr->next)
-		if (eptr->index >= ind) break;
+		return sizeof(SM_coeff_t);
+	}
+
+	return width;
+}
+
+/*
+ * Store the coefficient number k (starting with 0) into an array of them
+ * stored with the given width. The coefficient is assumed to fit.
+ */
+static inline void set_coeff(void *coeffs, int width, size_t k,
+							SM_coeff_t coeff)
+{
+	switch (width) {
+		case 1:
+			((int8_t *) coeffs)[k] = (int8_t) coeff;
+			break;
+		case 2:
+			((int16_t *) coeffs)[k] = (int16_t) coeff;
+			break;
+		case 4:
+			((int32_t *) coeffs)[k] = (int32_t) coeff;
+			break;
+		default:
+			((SM_coeff_t *) coeffs)[k] = coeff;
+	}
+}
 
-	if (eptr != NULL && eptr->index == ind) return eptr->value;
+/*
+ * Store a value at the position pos of a sparse vector. The value is
+ * assumed to fit into the vector's width.
+ */
+static inline void set_v_value(SparseVector *vec, SM_index_t pos,
+							SM_value_t val)
+{
+	int k;
+
+	for (k = 0; k < SM_NCOMP; k++)
+		set_coeff(vec->values, vec->width,
+				(size_t) pos * SM_NCOMP + k, SM_COMP(val, k));
+}
+
+/*
+ * Return the number of bytes n_entries values of a sparse vector take.
+ */
+#define VALUES_SIZE(n_entries, width) \
+			((size_t) (n_entries) * SM_NCOMP * (width))
+
+/*
+ * Make sure that a sparse vector has room for at least n_entries entries
+ * stored with (at least) the given width, promoting the existing values to
+ * a wider storage if necessary. Return 0 on success and -1 otherwise.
+ */
+static int reserve_v_entries(SparseVector *vec, SM_index_t n_entries,
+								int width)
+{
+	SM_index_t i, new_cap = vec->capacity;
+	SM_index_t *new_inds;
+	void *new_vals;
+	SparseVector new_vec;
+
+	if (width < vec->width) width = vec->width;
+	if (n_entries <= vec->capacity && width == vec->width) return 0;
+
+	if (n_entries > new_cap) {
+		if (new_cap < 2) new_cap = 2;
+		while (new_cap < n_entries) new_cap *= 2;
+
+		new_inds = (SM_index_t *)
+			realloc(vec->indices, new_cap * sizeof(SM_index_t));
+		if (new_inds == NULL)
+			ERRET_1("reserve_v_entries: not enough memory");
+		vec->indices = new_inds;
+	}
+
+	if (width == vec->width) {
+		new_vals = realloc(vec->values, VALUES_SIZE(new_cap, width));
+		if (new_vals == NULL)
+			ERRET_1("reserve_v_entries: not enough memory");
+	} else {
+		/* the vector is promoted, copy the values one by one */
+		if ((new_vals = malloc(VALUES_SIZE(new_cap, width))) == NULL)
+			ERRET_1("reserve_v_entries: not enough memory");
+
+		new_vec.width = width;
+		new_vec.values = new_vals;
+		for (i = 0; i < vec->num_entries; i++)
+			set_v_value(&new_vec, i, get_v_value(vec, i));
+
+		if (vec->values != NULL) free(vec->values);
+		vec->width = width;
+	}
+
+	vec->values = new_vals;
+	vec->capacity = new_cap;
 
 	return 0;
 }
 
 /*
- * Return index of the first invertible entry in a sparse vector (that is,
- * the one whose absolute value equals 1) or 0 if no such entry exists.
+ * Return the position of the first entry in a sparse vector whose index is
+ * at least ind (or the number of entries if there is no such one).
+ */
+static inline SM_index_t find_v_pos(SparseVector *vec, SM_index_t ind)
+{
+	SM_index_t low = 0, high = vec->num_entries, mid;
+
+	while (low < high) {
+		mid = (low + high) / 2;
+		if (vec->indices[mid] < ind)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return low;
+}
+
+/*
+ * Return the entry's value from a sparse vector (or zero if there is none).
+ */
+static SM_value_t get_v_entry(SparseVector *vec, SM_index_t ind)
+{
+	SM_index_t pos;
+
+	if (vec->num_entries <= 0) return SM_ZERO;
+
+	/* find the desired entry (if it exists) */
+	pos = find_v_pos(vec, ind);
+	if (pos < vec->num_entries && vec->indices[pos] == ind)
+		return get_v_value(vec, pos);
+
+	return SM_ZERO;
+}
+
+/*
+ * Return index of the first invertible entry in a sparse vector (for the
+ * integers, the one whose absolute value equals 1) or 0 if no such entry
+ * exists.
  * If val is not NULL, use it to store the value of the entry deleted.
  * Return -1 and set ERR_MESSAGE if the vector is already deleted.
  */
 SM_index_t find_v_unit(SparseVector *vec, SM_value_t *val)
 {
-	SparseEntry *eptr;
+	SM_index_t i;
+	SM_value_t cur_val;
 
 	if (vec->num_entries == -1)
 		ERRET_1("find_v_unit: vector is already deleted");
 
 	/* find the desired entry (if it exists) */
-	for (eptr = vec->entries; eptr != NULL; eptr = eptr->next) {
-		if (ABSFUNC(eptr->value) == 1) {
-			if (val != NULL) *val = eptr->value;
-			return eptr->index;
+	for (i = 0; i < vec->num_entries; i++) {
+		cur_val = get_v_value(vec, i);
+		if (is_val_unit(cur_val)) {
+			if (val != NULL) *val = cur_val;
+			return vec->indices[i];
 		}
 	}
 
@@ -75,32 +235,36 @@ SM_index_t find_v_unit(SparseVector *vec, SM_value_t *val)
 
 /*
  * Remove an entry given by its index from a sparse vector.
- * Return the value of the entry deleted (or 0 if there is none).
+ * Return the value of the entry deleted (or zero if there is none).
  * Return ERR_MVAL and set ERR_MESSAGE if the vector is already deleted.
  */
 static SM_value_t remove_v_entry(SparseVector *vec, SM_index_t ind)
 {
 	SM_value_t val;
-	SparseEntry *eptr, *prev = NULL;
+	SM_index_t pos, n_after;
+	char *vals;
 
 	if (vec->num_entries == -1)
 		ERRET_M("remove_v_entry: vector is already deleted");
 
 	/* find the entry to remove (if it exists) */
-	for (eptr = vec->entries; eptr != NULL; prev = eptr, eptr = eptr->next)
-		if (eptr->index >= ind) break;
+	pos = find_v_pos(vec, ind);
+	if (pos == vec->num_entries || vec->indices[pos] != ind)
+		return SM_ZERO;
 
-	if (eptr != NULL && eptr->index == ind) {
-		val = eptr->value;
-		if (prev != NULL)
-			prev->next = eptr->next;
-		else
-			vec->entries = eptr->next;
-		free(eptr);
+	val = get_v_value(vec, pos);
+
+	/* shift the rest of the entries back */
+	n_after = vec->num_entries - pos - 1;
+	vals = (char *) vec->values;
+	memmove(vec->indices + pos, vec->indices + pos + 1,
+					n_after * sizeof(SM_index_t));
+	memmove(vals + VALUES_SIZE(pos, vec->width),
+		vals + VALUES_SIZE(pos + 1, vec->width),
+					VALUES_SIZE(n_after, vec->width));
 
-		/* do we want to check that the number of entries >= 0 ?? */
-		vec->num_entries--;
-	} else return 0;
+	/* do we want to check that the number of entries >= 0 ?? */
+	vec->num_entries--;
 
 	return val;
 }
@@ -111,35 +275,37 @@ static SM_value_t remove_v_entry(SparseVector *vec, SM_index_t ind)
  */
 static int add_v_entry(SparseVector *vec, SM_index_t ind, SM_value_t val)
 {
-	SparseEntry *eptr, *prev = NULL;
+	SM_index_t pos, n_after;
+	char *vals;
 
 	if (vec->num_entries == -1)
 		ERRET_1("add_v_entry: vector is already deleted");
 
 	/* zero entries don't exist. Not having an entry to remove is OK */
-	if (val == 0) { remove_v_entry(vec, ind); return 0; }
+	if (is_val_zero(val)) { remove_v_entry(vec, ind); return 0; }
 
-	/* find an entry in the vector the new one should be added after */
-	for (eptr = vec->entries; eptr != NULL; prev = eptr, eptr = eptr->next)
-		if (eptr->index >= ind) break;
+	/* find an entry in the vector the new one should be added before */
+	pos = find_v_pos(vec, ind);
 
-	if (eptr != NULL && eptr->index == ind)
+	if (pos < vec->num_entries && vec->indices[pos] == ind) {
 		/* the entry already exists, only change its value than */
-		eptr->value = val;
-	else {
-		if ((eptr = malloc(sizeof(SparseEntry))) == NULL)
-			ERRET_1("add_v_entry: not enough memory");
-
-		eptr->index = ind;
-		eptr->value = val;
-
-		if (prev != NULL) {
-			eptr->next = prev->next;
-			prev->next = eptr;
-		} else {
-			eptr->next = vec->entries;
-			vec->entries = eptr;
-		}
+		if (reserve_v_entries(vec, vec->num_entries,
+					value_width(val)) == -1) return -1;
+		set_v_value(vec, pos, val);
+	} else {
+		if (reserve_v_entries(vec, vec->num_entries + 1,
+					value_width(val)) == -1) return -1;
+
+		n_after = vec->num_entries - pos;
+		vals = (char *) vec->values;
+		memmove(vec->indices + pos + 1, vec->indices + pos,
+					n_after * sizeof(SM_index_t));
+		memmove(vals + VALUES_SIZE(pos + 1, vec->width),
+			vals + VALUES_SIZE(pos, vec->width),
+					VALUES_SIZE(n_after, vec->width));
+
+		vec->indices[pos] = ind;
+		set_v_value(vec, pos, val);
 
 		/* do we want to check the number of entries is not too big? */
 		vec->num_entries++;
@@ -148,6 +314,24 @@ static int add_v_entry(SparseVector *vec, SM_index_t ind, SM_value_t val)
 	return 0;
 }
 
+/*
+ * Free the memory allocated for a sparse vector (but don't touch the root).
+ */
+static inline void kill_s_vector(SparseVector *vec)
+{
+	if (vec->indices != NULL) free(vec->indices);
+	if (vec->values != NULL) free(vec->values);
+
+	vec->indices = NULL;
+	vec->values = NULL;
+	vec->capacity = 0;
+	vec->width = 1;
+	vec->is_stale = 0;
+
+	/* deleted vectors stay deleted */
+	if (vec->num_entries > 0) vec->num_entries = 0;
+}
+
 /*
  * Check that row and column indices are within defined boundaries.
  */
@@ -160,7 +344,98 @@ static int check_m_indices(SparseMatrix *matr, SM_index_t row, SM_index_t col)
 }
 
 /*
- * Return the entry's value from a sparse matrix (or 0 if there is none).
+ * Compare two indices (for qsort).
+ */
+static int compare_indices(const void *ind1, const void *ind2)
+{
+	SM_index_t i1 = *((SM_index_t *) ind1), i2 = *((SM_index_t *) ind2);
+
+	return (i1 > i2) - (i1 < i2);
+}
+
+/*
+ * Put in order the list of rows of a column in a matrix stored by rows only:
+ * sort it and drop the repeated rows, as well as the ones without an entry
+ * in this column anymore.
+ */
+static void compact_c_index(SparseMatrix *matr, SM_index_t col)
+{
+	SparseVector *cvec = matr->columns + col - 1, *rvec;
+	SM_index_t i, pos, n_rows = 0;
+
+	if (! cvec->is_stale || cvec->num_entries == -1) return;
+
+	qsort(cvec->indices, cvec->num_entries, sizeof(SM_index_t),
+							compare_indices);
+
+	for (i = 0; i < cvec->num_entries; i++) {
+		if (n_rows > 0 && cvec->indices[n_rows - 1] == cvec->indices[i])
+			continue;
+
+		rvec = matr->rows + cvec->indices[i] - 1;
+		if (rvec->num_entries <= 0) continue;
+		pos = find_v_pos(rvec, col);
+		if (pos == rvec->num_entries || rvec->indices[pos] != col)
+			continue;
+
+		cvec->indices[n_rows++] = cvec->indices[i];
+	}
+
+	cvec->num_entries = n_rows;
+	cvec->is_stale = 0;
+}
+
+/*
+ * Append a row to the list of rows of a column in a matrix stored by rows
+ * only. A full list is put in order first if it's stale, so that it never
+ * grows much longer than the column itself.
+ * Return 0 on success and -1 otherwise.
+ */
+static int append_c_index(SparseMatrix *matr, SM_index_t col, SM_index_t row)
+{
+	SparseVector *cvec = matr->columns + col - 1;
+	SM_index_t new_cap, *new_inds;
+
+	if (cvec->num_entries == -1)
+		ERRET_1("append_c_index: column is already deleted");
+
+	if (cvec->num_entries == cvec->capacity) compact_c_index(matr, col);
+	if (cvec->num_entries == cvec->capacity) {
+		new_cap = (cvec->capacity < 2) ? 2 : 2 * cvec->capacity;
+		new_inds = (SM_index_t *)
+			realloc(cvec->indices, new_cap * sizeof(SM_index_t));
+		if (new_inds == NULL)
+			ERRET_1("append_c_index: not enough memory");
+		cvec->indices = new_inds;
+		cvec->capacity = new_cap;
+	}
+
+	/* rows appended in the increasing order keep the list in order */
+	if (cvec->num_entries > 0 &&
+			cvec->indices[cvec->num_entries - 1] >= row)
+		cvec->is_stale = 1;
+	cvec->indices[cvec->num_entries++] = row;
+
+	return 0;
+}
+
+/*
+ * Return a column of a sparse matrix, or NULL and set ERR_MESSAGE if the
+ * index is wrong. If the matrix is stored by rows only, the list of rows of
+ * the column is put in order first, but there are still no values there (use
+ * get_m_entry to get them).
+ */
+SparseVector *get_m_column(SparseMatrix *matr, SM_index_t col)
+{
+	if (check_m_indices(matr, 1, col) == -1) return NULL;
+
+	if (matr->rows_only) compact_c_index(matr, col);
+
+	return matr->columns + col - 1;
+}
+
+/*
+ * Return the entry's value from a sparse matrix (or zero if there is none).
  * If row and column entries differ, set an error message and return ERR_MVAL.
  */
 SM_value_t get_m_entry(SparseMatrix *matr, SM_index_t row, SM_index_t col)
@@ -172,7 +447,8 @@ SM_value_t get_m_entry(SparseMatrix *matr, SM_index_t row, SM_index_t col)
 	val = get_v_entry(matr->rows + row - 1, col);
 
 #ifdef SPARMAT_DEBUG
-	if (val != get_v_entry(matr->columns + col - 1, row))
+	if (! matr->rows_only && ! are_vals_equal(val,
+				get_v_entry(matr->columns + col - 1, row)))
 		ERRET_M("get_m_entry: row and column entries don't match");
 #endif
 
@@ -181,7 +457,7 @@ SM_value_t get_m_entry(SparseMatrix *matr, SM_index_t row, SM_index_t col)
 
 /*
  * Remove an entry given by its indices from a sparse matrix.
- * Return the value of the entry deleted (or 0 if there is none).
+ * Return the value of the entry deleted (or zero if there is none).
  * If row and column entries differ, set an error message and return ERR_MVAL.
  */
 SM_value_t remove_m_entry(SparseMatrix *matr, SM_index_t row, SM_index_t col)
@@ -191,38 +467,58 @@ SM_value_t remove_m_entry(SparseMatrix *matr, SM_index_t row, SM_index_t col)
 	if (check_m_indices(matr, row, col) == -1) return ERR_MVAL;
 
 	/* the row could be already deleted */
-	if ((valr = remove_v_entry(matr->rows + row - 1, col)) == ERR_MVAL)
-		return ERR_MVAL;
+	valr = remove_v_entry(matr->rows + row - 1, col);
+	if (IS_ERR_MVAL(valr)) return ERR_MVAL;
+
+	if (matr->rows_only) {
+		if (! is_val_zero(valr)) matr->columns[col - 1].is_stale = 1;
+		return valr;
+	}
 
 	/* the column could be already deleted */
-	if ((valc = remove_v_entry(matr->columns + col - 1, row)) == ERR_MVAL)
-		return ERR_MVAL;
+	valc = remove_v_entry(matr->columns + col - 1, row);
+	if (IS_ERR_MVAL(valc)) return ERR_MVAL;
 
-	if (valr != valc)
+	if (! are_vals_equal(valr, valc))
 		ERRET_M("remove_m_entry: row and column entries don't match");
 
 	return valr;
 }
 
 /*
- * Add entry given by its indices and value to a sparse matrix.
+ * Add entry given by its indices and value to a sparse matrix. The value
+ * is reduced first (modulo SM_PRIME or 2).
  * Return 0 on success and -1 otherwise.
  */
 int add_m_entry(SparseMatrix *matr,
 		SM_index_t row, SM_index_t col, SM_value_t val)
 {
+	SparseVector *rvec;
+	SM_index_t n_entries;
+	int k;
+
 	if (check_m_indices(matr, row, col) == -1) return -1;
 
-	if (val > ENTRY_MAX || val < -ENTRY_MAX)
+	val = reduce_val(val);
+	for (k = 0; k < SM_NCOMP; k++)
+		if (SM_COMP(val, k) > ENTRY_MAX || SM_COMP(val, k) < -ENTRY_MAX)
+			ERRET_1("add_m_entry: entry's value is too big");
+	if (val_norm(val) > ENTRY_MAX)
 		ERRET_1("add_m_entry: entry's value is too big");
 
 	/* zero entries don't exist. Not having an entry to remove is OK */
-	if (val == 0) {
-		if (remove_m_entry(matr, row, col) == ERR_MVAL) return -1;
+	if (is_val_zero(val)) {
+		if (IS_ERR_MVAL(remove_m_entry(matr, row, col))) return -1;
 		else return 0;
 	}
 
-	if (add_v_entry(matr->rows + row - 1, col, val) == -1) return -1;
+	rvec = matr->rows + row - 1;
+	n_entries = rvec->num_entries;
+	if (add_v_entry(rvec, col, val) == -1) return -1;
+
+	if (matr->rows_only)
+		return (rvec->num_entries > n_entries) ?
+					append_c_index(matr, col, row) : 0;
 
 	return add_v_entry(matr->columns + col - 1, row, val);
 }
@@ -237,34 +533,87 @@ static int erase_m_colrow(SparseVector *cr_vec, SM_index_t cr_ind,
 					SparseVector *others, int do_del)
 {
 	SM_value_t val;
-	SparseEntry *eptr = cr_vec->entries;
 
 	if (cr_vec->num_entries == -1)
 		ERRET_1("erase_m_colrow: vector is already deleted");
 
-	while (eptr != NULL) {
-		val = remove_v_entry(others + eptr->index - 1, cr_ind);
-		if (val == ERR_MVAL) return -1;
+	/* going from the end, the vector stays always sane */
+	while (cr_vec->num_entries > 0) {
+		val = remove_v_entry(others +
+			cr_vec->indices[cr_vec->num_entries - 1] - 1, cr_ind);
+		if (IS_ERR_MVAL(val)) return -1;
 
 #ifdef SPARMAT_DEBUG
-		if (val != eptr->value)
+		if (! are_vals_equal(val,
+				get_v_value(cr_vec, cr_vec->num_entries - 1)))
 			ERRET_1 \
 			("erase_m_colrow: row and column entries don't match");
 #endif
 
-		/* this way the vector stays always sane */
-		cr_vec->entries = eptr->next;
-		free(eptr);
 		cr_vec->num_entries--;
-		eptr = cr_vec->entries;
 	}
 
-#ifdef SPARMAT_DEBUG
-	if (cr_vec->num_entries != 0)
-		ERRET_1("erase_m_colrow: num_entries is not 0 after erasing");
-#endif
+	if (do_del) {
+		/* deleted vectors are never used again */
+		kill_s_vector(cr_vec);
+		cr_vec->num_entries = -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Erase all entries in a given row of a matrix stored by rows only. The lists
+ * of rows of the columns it has entries in become stale.
+ * If do_del is set, mark the row as being deleted.
+ * Return 0 on success and -1 otherwise.
+ */
+static int erase_r_row(SparseMatrix *matr, SM_index_t row, int do_del)
+{
+	SparseVector *rvec = matr->rows + row - 1;
+	SM_index_t i;
+
+	if (rvec->num_entries == -1)
+		ERRET_1("erase_r_row: vector is already deleted");
+
+	for (i = 0; i < rvec->num_entries; i++)
+		matr->columns[rvec->indices[i] - 1].is_stale = 1;
+	rvec->num_entries = 0;
+
+	if (do_del) {
+		kill_s_vector(rvec);
+		rvec->num_entries = -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Erase all entries in a given column of a matrix stored by rows only.
+ * If do_del is set, mark the column as being deleted.
+ * Return 0 on success and -1 otherwise.
+ */
+static int erase_r_column(SparseMatrix *matr, SM_index_t col, int do_del)
+{
+	SparseVector *cvec = matr->columns + col - 1;
+	SM_index_t i;
+
+	if (cvec->num_entries == -1)
+		ERRET_1("erase_r_column: vector is already deleted");
+
+	/* only the rows listed after that have entries to remove */
+	compact_c_index(matr, col);
+	for (i = 0; i < cvec->num_entries; i++)
+		if (IS_ERR_MVAL(remove_v_entry(matr->rows +
+					cvec->indices[i] - 1, col)))
+			return -1;
+	cvec->num_entries = 0;
+
+	if (do_del) {
+		kill_s_vector(cvec);
+		cvec->num_entries = -1;
+	}
 
-	if (do_del) cr_vec->num_entries = -1;
 	return 0;
 }
 
@@ -277,6 +626,8 @@ int erase_m_row(SparseMatrix *matr, SM_index_t row, int do_del)
 {
 	if (check_m_indices(matr, row, 1) == -1) return -1;
 
+	if (matr->rows_only) return erase_r_row(matr, row, do_del);
+
 	return erase_m_colrow(matr->rows + row - 1, row, matr->columns, do_del);
 }
 
@@ -289,85 +640,185 @@ int erase_m_column(SparseMatrix *matr, SM_index_t col, int do_del)
 {
 	if (check_m_indices(matr, 1, col) == -1) return -1;
 
+	if (matr->rows_only) return erase_r_column(matr, col, do_del);
+
 	return erase_m_colrow(matr->columns + col - 1, col, matr->rows, do_del);
 }
 
+/*
+ * Free the buffers used by add_m_colrows.
+ */
+static void free_sum_buffers(SM_index_t *sum_inds, SM_value_t *sum_vals,
+							char *is_matched)
+{
+	if (sum_inds != NULL) free(sum_inds);
+	if (sum_vals != NULL) free(sum_vals);
+	if (is_matched != NULL) free(is_matched);
+}
+
 /*
  * Add (with a scalar) two rows or columns of a sparse matrix, and assign the
  * corresponding entries in the ``orthogonal'' family of vectors appropriately.
- * Return the maximal absolute value of the new entries and -1 on failure.
+ * If the matrix is stored by rows only, these are the lists of rows of its
+ * columns, which are only appended to or marked as stale.
+ * Return the maximal norm of the new entries and -1 on failure.
+ *
+ * The sum is formed in a separate buffer first, so nothing is changed if
+ * some entry becomes too big (or overflows), in which case -2 is returned.
  */
-static SM_value_t add_m_colrows(SparseVector *cr_vec1, SM_index_t cr_ind1,
-	SparseVector *cr_vec2, SparseVector *others, SM_index_t scalar)
+static SM_coeff_t add_m_colrows(SparseMatrix *matr,
+	SparseVector *cr_vec1, SM_index_t cr_ind1,
+	SparseVector *cr_vec2, SparseVector *others, SM_value_t scalar)
 {
-	SM_value_t maxval = 0;
-	SparseEntry *prev = NULL, *new, *old;
-	SparseEntry *eptr1 = cr_vec1->entries, *eptr2 = cr_vec2->entries;
+	SM_coeff_t maxval = 0;
+	SM_value_t new_val, *sum_vals;
+	SM_index_t i1 = 0, i2 = 0, n_sum = 0, *sum_inds;
+	SM_index_t n1 = cr_vec1->num_entries, n2 = cr_vec2->num_entries;
+	char *is_matched = NULL;
+	int width = 1, is_new, too_big;
+
+	if (n1 == -1 || n2 == -1)
+		ERRET_1("add_m_colrows: vector is already deleted");
+
+	/* nothing to add */
+	if (n2 == 0) return 0;
+
+	sum_inds = (SM_index_t *) malloc((n1 + n2) * sizeof(SM_index_t));
+	sum_vals = (SM_value_t *) malloc((n1 + n2) * sizeof(SM_value_t));
+	/* entries of both vectors don't need to be added to the lists */
+	if (matr->rows_only) is_matched = (char *) malloc(n1 + n2);
+	if (sum_inds == NULL || sum_vals == NULL ||
+			(matr->rows_only && is_matched == NULL)) {
+		free_sum_buffers(sum_inds, sum_vals, is_matched);
+		ERRET_1("add_m_colrows: not enough memory");
+	}
 
-	if (cr_vec1->num_entries == -1 || cr_vec2->num_entries == -1)
-		ERRET_1("erase_m_colrow: vector is already deleted");
+	while (i1 < n1 || i2 < n2) {
+		is_new = too_big = 0;
+
+		if (i2 == n2 || (i1 < n1 &&
+				cr_vec1->indices[i1] < cr_vec2->indices[i2])) {
+			/* there is an unmatched entry in the first vector */
+			sum_inds[n_sum] = cr_vec1->indices[i1];
+			new_val = get_v_value(cr_vec1, i1++);
+		} else if (i1 == n1 ||
+				cr_vec1->indices[i1] > cr_vec2->indices[i2]) {
+			/* there is an unmatched entry in the second vector */
+			sum_inds[n_sum] = cr_vec2->indices[i2];
+			too_big = add_mult_vals(SM_ZERO, scalar,
+					get_v_value(cr_vec2, i2++), &new_val);
+			is_new = 1;
+			if (is_matched != NULL) is_matched[n_sum] = 0;
+		} else {
+			/* entries are matched: both indices are the same */
+			sum_inds[n_sum] = cr_vec1->indices[i1];
+			too_big = add_mult_vals(get_v_value(cr_vec1, i1++),
+				scalar, get_v_value(cr_vec2, i2++), &new_val);
+			is_new = 1;
+			if (is_matched != NULL) is_matched[n_sum] = 1;
+		}
 
-	while (eptr2 != NULL) {
-		/* there is an unmatched entries in the first vector */
-		if (eptr1 != NULL && eptr1->index < eptr2->index) {
-			prev = eptr1;
-			eptr1 = eptr1->next;
-			continue;
+		/* the matrix is not changed yet, so the caller can decide
+		 * what to do with the too big entries */
+		if (too_big) {
+			free_sum_buffers(sum_inds, sum_vals, is_matched);
+			ERR_RET("add_m_colrows: entry's value is too big", -2);
 		}
 
-		/* a trick to deal with newly created zero entries */
-		old = prev;
-
-		/* there is an unmatched entry in the second vector */
-		if (eptr1 == NULL || eptr1->index > eptr2->index) {
-			if ((new = malloc(sizeof(SparseEntry))) == NULL)
-				ERRET_1("add_m_colrows: not enough memory");
-
-			new->index = eptr2->index;
-			/* need to check for admissible values here !!! */
-			new->value = scalar * eptr2->value;
-			new->next = eptr1;
-			if (prev != NULL) {
-				prev->next = new;
-			} else {
-				cr_vec1->entries = new;
+		/* zero entries are kept in the buffer until the ``orthogonal''
+		 * vectors are updated */
+		sum_vals[n_sum] = new_val;
+		if (is_new && val_norm(new_val) > maxval)
+			maxval = val_norm(new_val);
+		if (value_width(new_val) > width)
+			width = value_width(new_val);
+		n_sum++;
+	}
+
+	if (reserve_v_entries(cr_vec1, n_sum, width) == -1) {
+		free_sum_buffers(sum_inds, sum_vals, is_matched);
+		return -1;
+	}
+
+	/* copy the sum back, this time without the zero entries */
+	cr_vec1->num_entries = 0;
+	for (i1 = i2 = 0; i1 < n_sum; i1++) {
+		/* entries not coming from the second vector stay the same */
+		if (! matr->rows_only && i2 < n2 &&
+				cr_vec2->indices[i2] == sum_inds[i1]) {
+			i2++;
+			if (add_v_entry(others + sum_inds[i1] - 1,
+					cr_ind1, sum_vals[i1]) == -1) {
+				free_sum_buffers(sum_inds, sum_vals, is_matched);
+				return -1;
 			}
-			cr_vec1->num_entries++;
+		}
 
-			if (ABSFUNC(new->value) > maxval)
-				maxval = ABSFUNC(new->value);
+		if (is_val_zero(sum_vals[i1])) continue;
 
-			prev = new;
-			eptr2 = eptr2->next;
-		} else {
-			/* entries are matched: both indices are the same */
-			eptr1->value += scalar * eptr2->value;
+		cr_vec1->indices[cr_vec1->num_entries] = sum_inds[i1];
+		set_v_value(cr_vec1, cr_vec1->num_entries++, sum_vals[i1]);
+	}
 
-			if (ABSFUNC(eptr1->value) > maxval)
-				maxval = ABSFUNC(eptr1->value);
+	/* the lists of rows are updated once the row itself is complete */
+	for (i1 = i2 = 0; matr->rows_only && i1 < n_sum; i1++) {
+		if (i2 == n2 || cr_vec2->indices[i2] != sum_inds[i1]) continue;
+		i2++;
 
-			prev = eptr1;
-			eptr1 = eptr1->next;
-			eptr2 = eptr2->next;
+		if (is_val_zero(sum_vals[i1]))
+			others[sum_inds[i1] - 1].is_stale = 1;
+		else if (! is_matched[i1] &&
+				append_c_index(matr, sum_inds[i1], cr_ind1) == -1) {
+			free_sum_buffers(sum_inds, sum_vals, is_matched);
+			return -1;
 		}
-		if (ABSFUNC(prev->value) > ENTRY_MAX)
-			ERRET_1("add_m_colrows: entry's value is too big");
+	}
 
-		if (add_v_entry(others + prev->index - 1,
-					cr_ind1, prev->value) == -1)
-			return -1;
+	free_sum_buffers(sum_inds, sum_vals, is_matched);
 
-		/* if the new entry's value is 0, remove the entry */
-		if (prev->value == 0) {
-			free(prev);
-			prev = old;
+	return maxval;
+}
 
-			if (prev != NULL)
-				prev->next = eptr1;
-			else
-				cr_vec1->entries = eptr1;
-			cr_vec1->num_entries--;
-		}
+/*
+ * Add (with a scalar) two columns of a matrix stored by rows only, going
+ * over the rows of the second column. Return the same as add_m_cols.
+ */
+static SM_coeff_t add_r_cols(SparseMatrix *matr,
+		SM_index_t col1, SM_index_t col2, SM_value_t scalar)
+{
+	SparseVector *cvec2 = matr->columns + col2 - 1, *rvec;
+	SM_coeff_t maxval = 0;
+	SM_value_t new_val;
+	SM_index_t i, n_entries;
+
+	if (matr->columns[col1 - 1].num_entries == -1 ||
+			cvec2->num_entries == -1)
+		ERRET_1("add_r_cols: vector is already deleted");
+
+	compact_c_index(matr, col2);
+
+	/* check all the new entries before changing anything */
+	for (i = 0; i < cvec2->num_entries; i++) {
+		rvec = matr->rows + cvec2->indices[i] - 1;
+		if (add_mult_vals(get_v_entry(rvec, col1), scalar,
+				get_v_entry(rvec, col2), &new_val))
+			ERR_RET("add_r_cols: entry's value is too big", -2);
+		if (val_norm(new_val) > maxval) maxval = val_norm(new_val);
+	}
+
+	for (i = 0; i < cvec2->num_entries; i++) {
+		rvec = matr->rows + cvec2->indices[i] - 1;
+		add_mult_vals(get_v_entry(rvec, col1), scalar,
+				get_v_entry(rvec, col2), &new_val);
+
+		n_entries = rvec->num_entries;
+		if (add_v_entry(rvec, col1, new_val) == -1) return -1;
+
+		if (rvec->num_entries < n_entries)
+			matr->columns[col1 - 1].is_stale = 1;
+		else if (rvec->num_entries > n_entries &&
+			append_c_index(matr, col1, cvec2->indices[i]) == -1)
+			return -1;
 	}
 
 	return maxval;
@@ -375,29 +826,34 @@ static SM_value_t add_m_colrows(SparseVector *cr_vec1, SM_index_t cr_ind1,
 
 /*
  * Add (with a scalar) two rows in a given sparse matrix.
- * Return the maximal absolute value of the new entries and -1 on failure.
+ * Return the maximal norm of the new entries and -1 on failure.
+ * If some new entry would be too big, return -2 and leave the matrix as is.
  */
-SM_value_t add_m_rows(SparseMatrix *matr,
+SM_coeff_t add_m_rows(SparseMatrix *matr,
 		SM_index_t row1, SM_index_t row2, SM_value_t scalar)
 {
 	if (check_m_indices(matr, row1, 1) == -1) return -1;
 	if (check_m_indices(matr, row2, 1) == -1) return -1;
 
-	return add_m_colrows(matr->rows + row1 - 1, row1,
+	return add_m_colrows(matr, matr->rows + row1 - 1, row1,
 				matr->rows + row2 - 1, matr->columns, scalar);
 }
 
 /*
  * Add (with a scalar) two columns in a given sparse matrix.
- * Return the maximal absolute value of the new entries and -1 on failure.
+ * Return the maximal norm of the new entries and -1 on failure.
+ * If some new entry would be too big, return -2 and leave the matrix as is.
  */
-SM_value_t add_m_cols(SparseMatrix *matr,
+SM_coeff_t add_m_cols(SparseMatrix *matr,
 		SM_index_t col1, SM_index_t col2, SM_value_t scalar)
 {
 	if (check_m_indices(matr, 1, col1) == -1) return -1;
 	if (check_m_indices(matr, 1, col2) == -1) return -1;
 
-	return add_m_colrows(matr->columns + col1 - 1, col1,
+	/* the rows hit by the second column are changed one by one */
+	if (matr->rows_only) return add_r_cols(matr, col1, col2, scalar);
+
+	return add_m_colrows(matr, matr->columns + col1 - 1, col1,
 				matr->columns + col2 - 1, matr->rows, scalar);
 }
 
@@ -427,33 +883,37 @@ int init_s_matrix(SparseMatrix *matr, SM_index_t n_rows, SM_index_t n_cols)
 	matr->num_cols = n_cols;
 	matr->rows = rvec;
 	matr->columns = cvec;
+	matr->rows_only = 0;
 
 	for (i = 0, vptr = rvec; i < n_rows; i++, vptr++) {
-		vptr->num_entries = 0;
-		vptr->entries = NULL;
+		vptr->num_entries = vptr->capacity = 0;
+		vptr->width = 1;
+		vptr->is_stale = 0;
+		vptr->indices = NULL;
+		vptr->values = NULL;
 	}
 	for (i = 0, vptr = cvec; i < n_cols; i++, vptr++) {
-		vptr->num_entries = 0;
-		vptr->entries = NULL;
+		vptr->num_entries = vptr->capacity = 0;
+		vptr->width = 1;
+		vptr->is_stale = 0;
+		vptr->indices = NULL;
+		vptr->values = NULL;
 	}
 
 	return 0;
 }
 
 /*
- * Free the memory allocated for a sparse vector (but don't touch the root).
+ * Allocate memory for a new sparse matrix stored by rows only.
+ * Return 0 on success and -1 otherwise.
  */
-static inline void kill_s_vector(SparseVector *vec)
+int init_r_matrix(SparseMatrix *matr, SM_index_t n_rows, SM_index_t n_cols)
 {
-	SparseEntry *eptr = vec->entries;
+	if (init_s_matrix(matr, n_rows, n_cols) == -1) return -1;
 
-	while (eptr != NULL) {
-		/* this way the vector stays always sane */
-		vec->entries = eptr->next;
-		free(eptr);
-		vec->num_entries--;
-		eptr = vec->entries;
-	}
+	matr->rows_only = 1;
+
+	return 0;
 }
 
 /*
@@ -478,6 +938,427 @@ void kill_s_matrix(SparseMatrix *matr)
 	}
 }
 
+/*
+ * Count the entries in a sparse matrix, as well as its non-deleted rows and
+ * columns (if the pointers are not NULL). Used to monitor the matrix fill.
+ */
+long count_m_entries(SparseMatrix *matr,
+		SM_index_t *n_rows, SM_index_t *n_cols)
+{
+	SM_index_t i, live_rows = 0, live_cols = 0;
+	long cnt = 0;
+
+	for (i = 0; i < matr->num_rows; i++) {
+		if (matr->rows[i].num_entries == -1) continue;
+		cnt += matr->rows[i].num_entries;
+		live_rows++;
+	}
+
+	for (i = 0; i < matr->num_cols; i++)
+		if (matr->columns[i].num_entries != -1) live_cols++;
+
+	if (n_rows != NULL) *n_rows = live_rows;
+	if (n_cols != NULL) *n_cols = live_cols;
+
+	return cnt;
+}
+
+/*
+ * An entry of a sparse vector being renumbered.
+ */
+typedef struct perm_entry {
+	SM_index_t index;
+	SM_value_t value;
+} PermEntry;
+
+/*
+ * Compare two entries by their indices (for qsort).
+ */
+static int compare_entries(const void *entry1, const void *entry2)
+{
+	SM_index_t ind1 = ((PermEntry *) entry1)->index;
+	SM_index_t ind2 = ((PermEntry *) entry2)->index;
+
+	return (ind1 > ind2) - (ind1 < ind2);
+}
+
+/*
+ * Renumber the indices of a sparse vector using perm (so that an index ind
+ * becomes perm[ind - 1]) and sort its entries again. The buffer buf must
+ * have room for all the entries.
+ */
+static void permute_s_vector(SparseVector *vec, SM_index_t *perm,
+							PermEntry *buf)
+{
+	SM_index_t i;
+
+	for (i = 0; i < vec->num_entries; i++) {
+		buf[i].index = perm[vec->indices[i] - 1];
+		buf[i].value = get_v_value(vec, i);
+	}
+
+	qsort(buf, vec->num_entries, sizeof(PermEntry), compare_entries);
+
+	for (i = 0; i < vec->num_entries; i++) {
+		vec->indices[i] = buf[i].index;
+		set_v_value(vec, i, buf[i].value);
+	}
+}
+
+/*
+ * Renumber the rows and columns of a sparse matrix, so that the row (column)
+ * number i becomes row_perm[i - 1] (col_perm[i - 1]). Both arrays must be
+ * permutations of 1, 2, ..., the number of rows (columns).
+ * Return 0 on success and -1 otherwise.
+ */
+int permute_m_matrix(SparseMatrix *matr,
+		SM_index_t *row_perm, SM_index_t *col_perm)
+{
+	SM_index_t i, j, max_len = 0;
+	SparseVector *new_rows, *new_cols;
+	PermEntry *buf;
+
+	for (i = 0; i < matr->num_rows; i++)
+		if (matr->rows[i].num_entries > max_len)
+			max_len = matr->rows[i].num_entries;
+	for (i = 0; i < matr->num_cols && ! matr->rows_only; i++)
+		if (matr->columns[i].num_entries > max_len)
+			max_len = matr->columns[i].num_entries;
+
+	/* get all the memory first to leave the matrix intact on failure */
+	buf = (PermEntry *) malloc((max_len + 1) * sizeof(PermEntry));
+	new_rows = (SparseVector *)
+			malloc(matr->num_rows * sizeof(SparseVector));
+	new_cols = (SparseVector *)
+			malloc(matr->num_cols * sizeof(SparseVector));
+	if (buf == NULL || new_rows == NULL || new_cols == NULL) {
+		if (buf != NULL) free(buf);
+		if (new_rows != NULL) free(new_rows);
+		if (new_cols != NULL) free(new_cols);
+		ERRET_1("permute_m_matrix: not enough memory");
+	}
+
+	for (i = 0; i < matr->num_rows; i++)
+		new_rows[row_perm[i] - 1] = matr->rows[i];
+	for (i = 0; i < matr->num_cols; i++)
+		new_cols[col_perm[i] - 1] = matr->columns[i];
+
+	free(matr->rows);
+	free(matr->columns);
+	matr->rows = new_rows;
+	matr->columns = new_cols;
+
+	/* deleted vectors have no entries to renumber */
+	for (i = 0; i < matr->num_rows; i++)
+		if (new_rows[i].num_entries > 0)
+			permute_s_vector(new_rows + i, col_perm, buf);
+	for (i = 0; i < matr->num_cols; i++) {
+		if (new_cols[i].num_entries <= 0) continue;
+
+		if (matr->rows_only) {
+			/* the lists of rows are sorted again when needed */
+			for (j = 0; j < new_cols[i].num_entries; j++)
+				new_cols[i].indices[j] =
+					row_perm[new_cols[i].indices[j] - 1];
+			new_cols[i].is_stale = 1;
+		} else
+			permute_s_vector(new_cols + i, row_perm, buf);
+	}
+
+	free(buf);
+	return 0;
+}
+
+#ifdef SM_DENSE
+/*
+ * Make a dense copy of the non-deleted part of a sparse matrix. If rows
+ * (or cols) is not NULL, only n_rows rows (or n_cols columns) whose indices
+ * are listed there are copied, and the entries of these rows must all lie
+ * in the columns copied.
+ * Return 0 on success, 1 if some entry is too big for a dense matrix,
+ * and -1 otherwise.
+ */
+int init_d_matrix(DenseMatrix *dmatr, SparseMatrix *matr,
+		SM_index_t *rows, SM_index_t n_rows,
+		SM_index_t *cols, SM_index_t n_cols)
+{
+	SM_index_t i, j, k, row, col, *col_map;
+	SM_value_t val;
+	DM_value_t *vptr;
+	SparseVector *vec;
+
+	if (rows == NULL) n_rows = matr->num_rows;
+	if (cols == NULL) n_cols = matr->num_cols;
+
+	/* count the non-deleted rows and columns */
+	dmatr->num_rows = dmatr->num_cols = 0;
+	for (k = 0; k < n_rows; k++) {
+		i = (rows == NULL) ? k : rows[k] - 1;
+		if (i < 0 || i >= matr->num_rows)
+			ERRET_1("init_d_matrix: wrong row index");
+		if (matr->rows[i].num_entries != -1) dmatr->num_rows++;
+	}
+	for (k = 0; k < n_cols; k++) {
+		i = (cols == NULL) ? k : cols[k] - 1;
+		if (i < 0 || i >= matr->num_cols)
+			ERRET_1("init_d_matrix: wrong column index");
+		if (matr->columns[i].num_entries != -1) dmatr->num_cols++;
+	}
+
+	if (dmatr->num_rows < 1 || dmatr->num_cols < 1)
+		ERRET_1("init_d_matrix: number of rows or columns is too small");
+
+	dmatr->values = (DM_value_t *) calloc((size_t) dmatr->num_rows *
+				dmatr->num_cols, sizeof(DM_value_t));
+	dmatr->row_inds = (SM_index_t *)
+				malloc(dmatr->num_rows * sizeof(SM_index_t));
+	dmatr->col_inds = (SM_index_t *)
+				malloc(dmatr->num_cols * sizeof(SM_index_t));
+	/* positions of the sparse columns in the dense matrix */
+	col_map = (SM_index_t *) malloc(matr->num_cols * sizeof(SM_index_t));
+	dmatr->max_abs = 0;
+
+	if (dmatr->values == NULL || dmatr->row_inds == NULL ||
+			dmatr->col_inds == NULL || col_map == NULL) {
+		if (col_map != NULL) free(col_map);
+		kill_d_matrix(dmatr);
+		ERRET_1("init_d_matrix: not enough memory");
+	}
+
+	for (i = 0; i < matr->num_cols; i++) col_map[i] = -1;
+	for (k = 0, col = 0; k < n_cols; k++) {
+		i = (cols == NULL) ? k : cols[k] - 1;
+		if (matr->columns[i].num_entries == -1) continue;
+		dmatr->col_inds[col] = i + 1;
+		col_map[i] = col++;
+	}
+
+	for (k = 0, row = 0; k < n_rows; k++) {
+		i = (rows == NULL) ? k : rows[k] - 1;
+		vec = matr->rows + i;
+		if (vec->num_entries == -1) continue;
+		dmatr->row_inds[row] = i + 1;
+
+		vptr = dmatr->values + (size_t) row * dmatr->num_cols;
+		for (j = 0; j < vec->num_entries; j++) {
+			val = get_v_value(vec, j);
+			if (val > DENSE_ENTRY_MAX || val < -DENSE_ENTRY_MAX) {
+				free(col_map);
+				kill_d_matrix(dmatr);
+				return 1;
+			}
+
+			if ((col = col_map[vec->indices[j] - 1]) == -1) {
+				free(col_map);
+				kill_d_matrix(dmatr);
+				ERRET_1("init_d_matrix: entry is outside of columns");
+			}
+
+			vptr[col] = val;
+			if (ABSFUNC(val) > dmatr->max_abs)
+				dmatr->max_abs = ABSFUNC(val);
+		}
+		row++;
+	}
+
+	free(col_map);
+	return 0;
+}
+
+/*
+ * Find an invertible entry in a dense matrix, starting from the row *row.
+ * Store its position in *row and *col and return its value (or 0 if no
+ * such entry exists).
+ */
+SM_value_t find_d_unit(DenseMatrix *dmatr, SM_index_t *row, SM_index_t *col)
+{
+	SM_index_t i, j, cur_row;
+	DM_value_t *vptr;
+
+	if (*row < 1 || *row > dmatr->num_rows) *row = 1;
+
+	/* go over all the rows cyclically */
+	for (i = 0, cur_row = *row - 1; i < dmatr->num_rows; i++, cur_row++) {
+		if (cur_row == dmatr->num_rows) cur_row = 0;
+
+		vptr = dmatr->values + (size_t) cur_row * dmatr->num_cols;
+		for (j = 0; j < dmatr->num_cols; j++) {
+			if (abs(vptr[j]) == 1) {
+				*row = cur_row + 1;
+				*col = j + 1;
+				return vptr[j];
+			}
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Add (with a scalar) the vector src of length len to the vector dst.
+ * Return the maximal absolute value of the new entries of dst. The caller
+ * must make sure that the new entries fit into DM_value_t.
+ */
+static DM_value_t axpy_d_vector(DM_value_t *dst, DM_value_t *src,
+					DM_value_t scalar, SM_index_t len)
+{
+	SM_index_t i = 0;
+	DM_value_t maxval = 0;
+#if defined(__AVX2__)
+	__m256i vscal = _mm256_set1_epi32(scalar), vmax = _mm256_setzero_si256();
+	__m256i vdst;
+	DM_value_t vals[8];
+	int k;
+
+	for (; i + 8 <= len; i += 8) {
+		vdst = _mm256_add_epi32(
+			_mm256_loadu_si256((__m256i *) (dst + i)),
+			_mm256_mullo_epi32(vscal,
+				_mm256_loadu_si256((__m256i *) (src + i))));
+		_mm256_storeu_si256((__m256i *) (dst + i), vdst);
+		vmax = _mm256_max_epi32(vmax, _mm256_abs_epi32(vdst));
+	}
+
+	_mm256_storeu_si256((__m256i *) vals, vmax);
+	for (k = 0; k < 8; k++) if (vals[k] > maxval) maxval = vals[k];
+#elif defined(__SSE4_1__)
+	__m128i vscal = _mm_set1_epi32(scalar), vmax = _mm_setzero_si128();
+	__m128i vdst;
+	DM_value_t vals[4];
+	int k;
+
+	for (; i + 4 <= len; i += 4) {
+		vdst = _mm_add_epi32(
+			_mm_loadu_si128((__m128i *) (dst + i)),
+			_mm_mullo_epi32(vscal,
+				_mm_loadu_si128((__m128i *) (src + i))));
+		_mm_storeu_si128((__m128i *) (dst + i), vdst);
+		vmax = _mm_max_epi32(vmax, _mm_abs_epi32(vdst));
+	}
+
+	_mm_storeu_si128((__m128i *) vals, vmax);
+	for (k = 0; k < 4; k++) if (vals[k] > maxval) maxval = vals[k];
+#endif
+
+	/* the remaining entries (or all of them without SIMD) */
+	for (; i < len; i++) {
+		dst[i] = (DM_value_t) (dst[i] + (long long) scalar * src[i]);
+		if (abs(dst[i]) > maxval) maxval = abs(dst[i]);
+	}
+
+	return maxval;
+}
+
+/*
+ * Check whether adding (with a scalar) the vector src to the vector dst
+ * would make some entry of dst too big. Return 1 if this is the case.
+ */
+static int check_d_vector(DM_value_t *dst, DM_value_t *src,
+					DM_value_t scalar, SM_index_t len)
+{
+	SM_index_t i;
+	long long new_val;
+
+	for (i = 0; i < len; i++) {
+		new_val = dst[i] + (long long) scalar * src[i];
+		if (new_val > DENSE_ENTRY_MAX || new_val < -DENSE_ENTRY_MAX)
+			return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Eliminate an invertible entry of a dense matrix by adding multiples of
+ * its column to all the other ones. Both the row and the column of the
+ * entry are zeroed out afterwards.
+ * Return 0 on success and -1 otherwise. If some new entry would be too big
+ * for a dense matrix, return 1 and leave the matrix as is.
+ */
+int eliminate_d_unit(DenseMatrix *dmatr, SM_index_t row, SM_index_t col)
+{
+	SM_index_t i, n_cols = dmatr->num_cols;
+	DM_value_t *pivot_row, *vptr, *scalars, maxval, coeff, pivot;
+	long long bound = dmatr->max_abs;
+
+	if (row < 1 || row > dmatr->num_rows || col < 1 || col > n_cols)
+		ERRET_1("eliminate_d_unit: wrong matrix indices");
+
+	pivot_row = dmatr->values + (size_t) (row - 1) * n_cols;
+	pivot = pivot_row[col - 1];
+	if (abs(pivot) != 1)
+		ERRET_1("eliminate_d_unit: entry is not invertible");
+
+	if ((scalars = (DM_value_t *) malloc(n_cols * sizeof(DM_value_t)))
+			== NULL)
+		ERRET_1("eliminate_d_unit: not enough memory");
+
+	/* the pivot is its own inverse. Adding scalars[j] times the pivot
+	 * column to the column j kills the pivot row (and the column itself) */
+	for (i = 0; i < n_cols; i++)
+		scalars[i] = -pivot_row[i] * pivot;
+	scalars[col - 1] = 0;
+
+	/* no entry can become too big if the first condition is true.
+	 * Otherwise check all the rows before changing anything */
+	if (bound * bound + bound > DENSE_ENTRY_MAX) {
+		for (i = 0; i < dmatr->num_rows; i++) {
+			if (i == row - 1) continue;
+			vptr = dmatr->values + (size_t) i * n_cols;
+			if ((coeff = vptr[col - 1]) == 0) continue;
+
+			if (check_d_vector(vptr, scalars, coeff, n_cols)) {
+				free(scalars);
+				return 1;
+			}
+		}
+	}
+
+	for (i = 0; i < n_cols; i++) pivot_row[i] = 0;
+
+	for (i = 0; i < dmatr->num_rows; i++) {
+		vptr = dmatr->values + (size_t) i * n_cols;
+		if ((coeff = vptr[col - 1]) == 0) continue;
+
+		maxval = axpy_d_vector(vptr, scalars, coeff, n_cols);
+		vptr[col - 1] = 0;
+		if (maxval > dmatr->max_abs) dmatr->max_abs = maxval;
+	}
+
+	free(scalars);
+	return 0;
+}
+
+/*
+ * Free the memory allocated for a dense matrix.
+ */
+void kill_d_matrix(DenseMatrix *dmatr)
+{
+	if (dmatr->values != NULL) free(dmatr->values);
+	if (dmatr->row_inds != NULL) free(dmatr->row_inds);
+	if (dmatr->col_inds != NULL) free(dmatr->col_inds);
+
+	dmatr->values = NULL;
+	dmatr->row_inds = dmatr->col_inds = NULL;
+	dmatr->num_rows = dmatr->num_cols = 0;
+}
+#endif // #ifdef SM_DENSE
+
+/*
+ * For testing only: print a (non-zero) value to stdout.
+ */
+void print_val(SM_value_t val)
+{
+#ifdef SM_RING_U
+	if (val.c[0] != 0)
+		printf("%ld%s", val.c[0], val.c[1] > 0 ? "+" : "");
+	if (val.c[1] != 0)
+		printf("%ldt", val.c[1]);
+#else
+	printf("%ld", (long) val);
+#endif
+}
+
 /*
  * For testing only: print the content of a sparse vector to stdout.
  * Deleted vectors are ignored.
@@ -485,19 +1366,20 @@ void kill_s_matrix(SparseMatrix *matr)
 int print_s_vector(SparseVector *vec)
 {
 	SM_index_t i, num_e = vec->num_entries;
-	SparseEntry *eptr = vec->entries;
 
 	if (num_e == -1) {
 		printf("vector is deleted\n");
 		return 0;
 	}
 
-	printf("%d entries: ", num_e);
-	for (i = 0; i < num_e; i++, eptr = eptr->next) {
-		if (eptr == NULL) ERRET_1("print_vector: vector is corrupt");
+	if (num_e > vec->capacity) ERRET_1("print_vector: vector is corrupt");
 
+	printf("%d entries (%d x %d bytes each): ", num_e, SM_NCOMP,
+							vec->width);
+	for (i = 0; i < num_e; i++) {
 		if (i) printf("; ");
-		printf("%d, %d", eptr->index, eptr->value);
+		printf("%d, ", vec->indices[i]);
+		print_val(get_v_value(vec, i));
 	}
 
 	printf(".\n");
@@ -509,7 +1391,7 @@ int print_s_vector(SparseVector *vec)
  */
 int print_s_matrix(SparseMatrix *matr)
 {
-	SM_index_t i;
+	SM_index_t i, j;
 	SparseVector *vec;
 
 	printf("%d rows and %d columns:\n", matr->num_rows, matr->num_cols);
@@ -520,7 +1402,21 @@ int print_s_matrix(SparseMatrix *matr)
 	printf("\n");
 	for (i = 0, vec = matr->columns; i < matr->num_cols; i++, vec++) {
 		printf("  The column number %d, ", i + 1);
-		if (print_s_vector(vec) == -1) return -1;
+		if (! matr->rows_only) {
+			if (print_s_vector(vec) == -1) return -1;
+			continue;
+		}
+
+		/* only the rows are there */
+		compact_c_index(matr, i + 1);
+		if (vec->num_entries == -1) {
+			printf("vector is deleted\n");
+			continue;
+		}
+		printf("%d entries in the rows: ", vec->num_entries);
+		for (j = 0; j < vec->num_entries; j++)
+			printf(j ? ", %d" : "%d", vec->indices[j]);
+		printf(".\n");
 	}
 
 	return 0;
@@ -536,39 +1432,78 @@ int check_v_data(SparseVector *vec, SM_index_t max_index, SM_index_t v_ind,
 {
 	SM_index_t i, oldind = -1, n_entries;
 	SM_value_t val;
-	SparseEntry *eptr;
 
 	n_entries = vec->num_entries;
 	if (n_entries > max_index)
 		ERRET_1("check_v_data: number of entries is too big");
 	if (n_entries < -1 )
 		ERRET_1("check_v_data: number of entries is negative");
-	if (n_entries == -1 && vec->entries != NULL)
+	if (n_entries == -1 && vec->indices != NULL)
 		ERRET_1("check_v_data: deleted vector is not empty");
-
-	if (n_entries == -1) n_entries = 0;
-
-	for (eptr = vec->entries, i = 1; eptr != NULL; eptr = eptr->next, i++) {
-		if (eptr->index < 1)
+	if (n_entries > vec->capacity)
+		ERRET_1("check_v_data: number of entries exceeds capacity");
+	if (vec->width != 1 && vec->width != 2 && vec->width != 4 &&
+					vec->width != sizeof(SM_coeff_t))
+		ERRET_1("check_v_data: wrong width of values");
+
+	for (i = 0; i < n_entries; i++) {
+		if (vec->indices[i] < 1)
 			ERRET_1("check_v_data: index is not positive");
-		if (eptr->index > max_index)
+		if (vec->indices[i] > max_index)
 			ERRET_1("check_v_data: index is too big");
-		if (eptr->index <= oldind)
+		if (vec->indices[i] <= oldind)
 			ERRET_1("check_v_data: index is not increasing");
 
-		if (eptr->value == 0)
+		if (is_val_zero(val = get_v_value(vec, i)))
 			ERRET_1("check_v_data: value is 0");
 
-		oldind = eptr->index;
+		oldind = vec->indices[i];
 		if (others == NULL) continue;
 
-		val = get_v_entry(others + eptr->index - 1, v_ind);
-		if (val != eptr->value)
+		if (! are_vals_equal(val,
+				get_v_entry(others + vec->indices[i] - 1, v_ind)))
 			ERRET_1("check_v_data: rows and columns don't match");
+	}
 
+	return 0;
+}
+
+/*
+ * For testing only: check that the data of a matrix stored by rows only are
+ * consistent. Every list of rows is put in order, after which every entry
+ * has to be listed exactly once.
+ */
+static int check_r_data(SparseMatrix *matr)
+{
+	SM_index_t i, j;
+	SparseVector *vec;
+	long n_entries = 0;
+
+	for (i = 0, vec = matr->rows; i < matr->num_rows; i++, vec++) {
+		if (check_v_data(vec, matr->num_cols, i + 1, NULL) == -1)
+			return -1;
+		if (vec->num_entries > 0) n_entries += vec->num_entries;
+	}
+
+	for (i = 0, vec = matr->columns; i < matr->num_cols; i++, vec++) {
+		compact_c_index(matr, i + 1);
+		if (vec->num_entries == -1) continue;
+		if (vec->num_entries > vec->capacity)
+			ERRET_1("check_r_data: number of entries exceeds capacity");
+
+		/* the lists only keep the rows having an entry there */
+		for (j = 0; j < vec->num_entries; j++) {
+			if (vec->indices[j] < 1 || vec->indices[j] > matr->num_rows)
+				ERRET_1("check_r_data: index is out of range");
+			if (j > 0 && vec->indices[j] <= vec->indices[j - 1])
+				ERRET_1("check_r_data: index is not increasing");
+		}
+		n_entries -= vec->num_entries;
 	}
-	if (i != n_entries + 1)
-		ERRET_1("check_v_data: wrong number of entries");
+
+	/* so the lists can't miss anything if the counts agree */
+	if (n_entries != 0)
+		ERRET_1("check_r_data: rows and columns don't match");
 
 	return 0;
 }
@@ -582,6 +1517,8 @@ int check_m_data(SparseMatrix *matr)
 	SM_index_t n_rows = matr->num_rows, n_cols = matr->num_cols;
 	SparseVector *vec;
 
+	if (matr->rows_only) return check_r_data(matr);
+
 	for (i = 0, vec = matr->rows; i < n_rows; i++, vec++)
 		if (check_v_data(vec, n_rows, i + 1, matr->columns) == -1)
 			return -1;
@@ -19,88 +19,409 @@
  *
  */
 
+#include <stdint.h>
+#include <stdlib.h>
+#include <limits.h>
+
 /*
- * Types for indices and values of matrix entries.
- * 4 bytes (i.e. up to 2^32) is enough for the moment.
+ * The ring the matrix entries belong to is chosen at compile time by
+ * defining one of the following (the library and its users must agree):
+ *   SM_RING_LONG --> integers that fit into a long (default),
+ *   SM_RING_INT  --> integers that fit into an int,
+ *   SM_RING_U    --> Z[t]/(t^2=1) of Putyra's unified theory,
+ *   SM_RING_MODP --> Z/p for a prime SM_PRIME < 2^31 (2^31 - 1 by default,
+ *                    or the variable sm_prime if SM_PRIME_RUNTIME is defined),
+ *   SM_RING_GF2  --> Z/2.
+ *
+ * Every value consists of SM_NCOMP coefficients of type SM_coeff_t, and
+ * SM_COMP(val, k) is the k-th of them. Norms of values (the absolute value
+ * for integers) are of type SM_coeff_t as well.
+ */
+#if !defined(SM_RING_INT) && !defined(SM_RING_U) && \
+		!defined(SM_RING_MODP) && !defined(SM_RING_GF2)
+#  define SM_RING_LONG
+#endif
+
+/*
+ * Type for indices of matrix entries.
+ * 4 bytes (i.e. up to 2^32) is enough for indices. Values can take up to
+ * 8 bytes per coefficient, but are stored in as few bytes as possible
+ * (see SparseVector).
  */
 typedef int SM_index_t;
-typedef int SM_value_t;
+
+#if defined(SM_RING_LONG) || defined(SM_RING_INT)
+
+#  ifdef SM_RING_LONG
+typedef long SM_coeff_t;
+#    define ABSFUNC labs
+#    define ENTRY_MAX (LONG_MAX / 2)
+#    define ERR_MVAL LONG_MAX
+#  else
+typedef int SM_coeff_t;
+#    define ABSFUNC abs
+#    define ENTRY_MAX (INT_MAX / 2)
+#    define ERR_MVAL INT_MAX
+#  endif
+
+typedef SM_coeff_t SM_value_t;
+#  define SM_NCOMP 1
+#  define SM_COMP(val, k) (val)
+
+/* dense matrices are only used for integers */
+#  define SM_DENSE
+
+static inline SM_coeff_t val_norm(SM_value_t val) { return ABSFUNC(val); }
+static inline int is_val_unit(SM_value_t val) { return ABSFUNC(val) == 1; }
+static inline SM_value_t reduce_val(SM_value_t val) { return val; }
+static inline SM_value_t neg_val(SM_value_t val) { return -val; }
+
+/* units are \pm 1, so each of them is its own inverse */
+static inline SM_value_t inv_val(SM_value_t val) { return val; }
+
+static inline SM_value_t mult_vals(SM_value_t val1, SM_value_t val2)
+{
+	return val1 * val2;
+}
 
 /*
- * Function to compute the absolute value (depends on the type of entries)
+ * Compute val1 + scalar * val2 and store it in res.
+ * Return 1 if the result overflows or is too big and 0 otherwise.
  */
-#define ABSFUNC abs
+static inline int add_mult_vals(SM_value_t val1, SM_value_t scalar,
+				SM_value_t val2, SM_value_t *res)
+{
+	return __builtin_mul_overflow(scalar, val2, res) ||
+		__builtin_add_overflow(*res, val1, res) ||
+		*res > ENTRY_MAX || *res < -ENTRY_MAX;
+}
+
+#elif defined(SM_RING_U)
 
 /*
- * Maximal entry allowed (in absolute value).
+ * An element a + b t of Z[t]/(t^2=1) is stored as {a, b}.
  */
-#define ENTRY_MAX (INT_MAX / 2)
+typedef long SM_coeff_t;
+typedef struct { SM_coeff_t c[2]; } SM_value_t;
+#  define SM_NCOMP 2
+#  define SM_COMP(val, k) ((val).c[k])
+
+#  define ABSFUNC(val) (labs((val).c[0]) + labs((val).c[1]))
+#  define ENTRY_MAX (LONG_MAX / 2)
+#  define ERR_MVAL ((SM_value_t) {{LONG_MAX, LONG_MAX}})
+
+static inline SM_coeff_t val_norm(SM_value_t val) { return ABSFUNC(val); }
+static inline SM_value_t reduce_val(SM_value_t val) { return val; }
+
+/* the units are \pm 1 and \pm t, each of them is its own inverse */
+static inline int is_val_unit(SM_value_t val) { return ABSFUNC(val) == 1; }
+static inline SM_value_t inv_val(SM_value_t val) { return val; }
+
+static inline SM_value_t neg_val(SM_value_t val)
+{
+	return (SM_value_t) {{-val.c[0], -val.c[1]}};
+}
+
+static inline SM_value_t mult_vals(SM_value_t val1, SM_value_t val2)
+{
+	return (SM_value_t) {{val1.c[0] * val2.c[0] + val1.c[1] * val2.c[1],
+			val1.c[0] * val2.c[1] + val1.c[1] * val2.c[0]}};
+}
 
 /*
- * Maximal possible entry value.
+ * Compute val1 + scalar * val2 and store it in res.
+ * Return 1 if the result overflows or is too big and 0 otherwise.
  */
-#define ERR_MVAL INT_MAX
+static inline int add_mult_vals(SM_value_t val1, SM_value_t scalar,
+				SM_value_t val2, SM_value_t *res)
+{
+	SM_coeff_t prod[4];
+
+	if (__builtin_mul_overflow(scalar.c[0], val2.c[0], prod) ||
+		__builtin_mul_overflow(scalar.c[1], val2.c[1], prod + 1) ||
+		__builtin_mul_overflow(scalar.c[0], val2.c[1], prod + 2) ||
+		__builtin_mul_overflow(scalar.c[1], val2.c[0], prod + 3) ||
+		__builtin_add_overflow(prod[0], prod[1], res->c) ||
+		__builtin_add_overflow(prod[2], prod[3], res->c + 1) ||
+		__builtin_add_overflow(res->c[0], val1.c[0], res->c) ||
+		__builtin_add_overflow(res->c[1], val1.c[1], res->c + 1))
+			return 1;
+
+	if (res->c[0] > ENTRY_MAX || res->c[0] < -ENTRY_MAX ||
+		res->c[1] > ENTRY_MAX || res->c[1] < -ENTRY_MAX) return 1;
 
-extern char *ERR_MESSAGE;
+	return ABSFUNC(*res) > ENTRY_MAX;
+}
+
+#elif defined(SM_RING_MODP)
 
 /*
- * Entry of a sparse vector. Members are:
- *   index of the entry in the vector (starting with 1),
- *   pointer to the next entry (NULL if none).
+ * Residues are kept in the range 0, ..., SM_PRIME - 1, so they fit into
+ * 4 bytes, and their products into a long long.
  */
-typedef struct sparse_entry {
-	SM_index_t index;
-	SM_value_t value;
-	struct sparse_entry *next;
-} SparseEntry;
+#  ifdef SM_PRIME_RUNTIME
+/* the prime is chosen at run time by the user of the library */
+extern long sm_prime;
+#    define SM_PRIME sm_prime
+#  elif !defined(SM_PRIME)
+#    define SM_PRIME 2147483647L
+#  endif
+
+typedef long SM_coeff_t;
+typedef SM_coeff_t SM_value_t;
+#  define SM_NCOMP 1
+#  define SM_COMP(val, k) (val)
+
+#  define ABSFUNC(val) ((val) != 0)
+#  define ENTRY_MAX (LONG_MAX / 2)
+#  define ERR_MVAL LONG_MAX
+
+/* entries never grow, so the norm is 1 for every non-zero one */
+static inline SM_coeff_t val_norm(SM_value_t val) { return val != 0; }
+static inline int is_val_unit(SM_value_t val) { return val != 0; }
+
+static inline SM_value_t reduce_val(SM_value_t val)
+{
+	val %= SM_PRIME;
+	return (val < 0) ? val + SM_PRIME : val;
+}
+
+static inline SM_value_t neg_val(SM_value_t val)
+{
+	return (val == 0) ? 0 : SM_PRIME - val;
+}
+
+static inline SM_value_t mult_vals(SM_value_t val1, SM_value_t val2)
+{
+	return (SM_value_t) ((long long) val1 * val2 % SM_PRIME);
+}
+
+/*
+ * Invert a non-zero residue by raising it to the power SM_PRIME - 2.
+ */
+static inline SM_value_t inv_val(SM_value_t val)
+{
+	SM_value_t res = 1;
+	long e = SM_PRIME - 2;
+
+	for (; e > 0; e >>= 1) {
+		if (e & 1) res = mult_vals(res, val);
+		val = mult_vals(val, val);
+	}
+
+	return res;
+}
+
+/*
+ * Compute val1 + scalar * val2 and store it in res. Never overflows.
+ */
+static inline int add_mult_vals(SM_value_t val1, SM_value_t scalar,
+				SM_value_t val2, SM_value_t *res)
+{
+	*res = (SM_value_t)
+		(((long long) scalar * val2 + val1) % SM_PRIME);
+	return 0;
+}
+
+#elif defined(SM_RING_GF2)
+
+typedef long SM_coeff_t;
+typedef SM_coeff_t SM_value_t;
+#  define SM_NCOMP 1
+#  define SM_COMP(val, k) (val)
+
+#  define ABSFUNC(val) (val)
+#  define ENTRY_MAX (LONG_MAX / 2)
+#  define ERR_MVAL LONG_MAX
+
+static inline SM_coeff_t val_norm(SM_value_t val) { return val; }
+static inline int is_val_unit(SM_value_t val) { return val != 0; }
+static inline SM_value_t reduce_val(SM_value_t val) { return val & 1; }
+static inline SM_value_t neg_val(SM_value_t val) { return val; }
+static inline SM_value_t inv_val(SM_value_t val) { return val; }
+
+static inline SM_value_t mult_vals(SM_value_t val1, SM_value_t val2)
+{
+	return val1 & val2;
+}
+
+/*
+ * Compute val1 + scalar * val2 and store it in res. Never overflows.
+ */
+static inline int add_mult_vals(SM_value_t val1, SM_value_t scalar,
+				SM_value_t val2, SM_value_t *res)
+{
+	*res = val1 ^ (scalar & val2);
+	return 0;
+}
+
+#endif
+
+/*
+ * Zero of the ring, and checks for zero and equality.
+ */
+static const SM_value_t SM_ZERO;
+
+static inline int are_vals_equal(SM_value_t val1, SM_value_t val2)
+{
+	int k;
+
+	for (k = 0; k < SM_NCOMP; k++)
+		if (SM_COMP(val1, k) != SM_COMP(val2, k)) return 0;
+
+	return 1;
+}
+
+static inline int is_val_zero(SM_value_t val)
+{
+	return are_vals_equal(val, SM_ZERO);
+}
+
+#ifdef SM_DENSE
+/*
+ * Type of entries of dense matrices and the maximal entry allowed there.
+ * Dense matrices are never used for blocks with bigger entries.
+ */
+typedef int32_t DM_value_t;
+#  define DENSE_ENTRY_MAX (INT32_MAX / 2)
+#endif
+
+/*
+ * Message describing the last error. Every thread has its own, so that
+ * the threads eliminating pivots at once (see sparreduce.c) never report
+ * each other's errors.
+ */
+extern __thread char *ERR_MESSAGE;
 
 /*
  * Root of a sparse vector (either a row or a column). Members are:
  *   number of (non-zero) entries, 0 ==> no entries, -1 ==> vector is deleted,
- *   pointer to the first entry (NULL if none).
+ *   number of entries the arrays below have room for,
+ *   width (in bytes) of each coefficient of the values stored: 1, 2, 4,
+ *     or sizeof(SM_coeff_t),
+ *   array of indices of the entries (starting with 1) in increasing order,
+ *   array of coefficients of the entries of the given width (SM_NCOMP
+ *     per entry),
+ *   whether the vector is a stale list of rows (see SparseMatrix).
  *
+ * Values are stored using the narrowest width they all fit in, and the vector
+ * is promoted to a wider storage only when a new value doesn't fit anymore.
  * Deleted vectors are assumed to be not modifiable.
  */
 typedef struct sparse_vector {
-	SM_index_t num_entries;
-	SparseEntry *entries;
+	SM_index_t num_entries, capacity;
+	int width, is_stale;
+	SM_index_t *indices;
+	void *values;
 } SparseVector;
 
+/*
+ * Return the coefficient number k (starting with 0) of an array of them
+ * stored with the given width. No checks are made.
+ */
+static inline SM_coeff_t get_coeff(void *coeffs, int width, size_t k)
+{
+	switch (width) {
+		case 1:
+			return ((int8_t *) coeffs)[k];
+		case 2:
+			return ((int16_t *) coeffs)[k];
+		case 4:
+			return ((int32_t *) coeffs)[k];
+		default:
+			return ((SM_coeff_t *) coeffs)[k];
+	}
+}
+
+/*
+ * Return the value of the entry number pos (starting with 0) in a sparse
+ * vector. No checks are made.
+ */
+static inline SM_value_t get_v_value(SparseVector *vec, SM_index_t pos)
+{
+	SM_value_t val;
+	int k;
+
+	for (k = 0; k < SM_NCOMP; k++)
+		SM_COMP(val, k) = get_coeff(vec->values, vec->width,
+					(size_t) pos * SM_NCOMP + k);
+
+	return val;
+}
+
 /*
  * Root of a sparse matrix. Members are:
  *   number of rows and columns in the matrix,
- *   pointers to arrays of sparse vector roots representing rows and columns.
+ *   pointers to arrays of sparse vector roots representing rows and columns,
+ *   whether the matrix is stored by rows only.
  *
  * Arrays must be of length num_rows and num_cols, respectively.
+ *
+ * Normally every entry is stored twice, in its row and in its column. In
+ * a matrix stored by rows only (see init_r_matrix) the columns have no values
+ * and merely list the rows their entries are in. These lists are updated
+ * lazily: new rows are appended at the end, while rows that lose their
+ * entries are not removed. Such a list is marked as stale and put in order
+ * (sorted, without repetitions and rows that are gone) only when the column
+ * is asked for by get_m_column or the list runs out of room.
  */
 typedef struct sparse_matrix {
 	SM_index_t num_rows, num_cols;
 	SparseVector *rows, *columns;
+	int rows_only;
 } SparseMatrix;
 
+#ifdef SM_DENSE
+/*
+ * Dense copy of the non-deleted part of a sparse matrix. Members are:
+ *   number of rows and columns in the dense matrix,
+ *   array of num_rows * num_cols entries stored row by row,
+ *   indices of the rows and columns in the original sparse matrix,
+ *   upper bound for the absolute values of all the entries.
+ *
+ * Rows and columns that are eliminated are zeroed out, but not removed.
+ */
+typedef struct dense_matrix {
+	SM_index_t num_rows, num_cols;
+	DM_value_t *values;
+	SM_index_t *row_inds, *col_inds;
+	DM_value_t max_abs;
+} DenseMatrix;
+#endif
+
 /*
- * Return index of the first invertible entry in a sparse vector (that is,
- * the one whose absolute value equals 1) or 0 if no such entry exists.
+ * Return index of the first invertible entry in a sparse vector (for the
+ * integers, the one whose absolute value equals 1) or 0 if no such entry
+ * exists.
  * If val is not NULL, use it to store the value of the entry deleted.
  * Return -1 and set ERR_MESSAGE if the vector is already deleted.
  */
 SM_index_t find_v_unit(SparseVector *vec, SM_value_t *val);
 
 /*
- * Return the entry's value from a sparse matrix (or 0 if there is none).
+ * Return a column of a sparse matrix, or NULL and set ERR_MESSAGE if the
+ * index is wrong. If the matrix is stored by rows only, the list of rows of
+ * the column is put in order first, but there are still no values there (use
+ * get_m_entry to get them).
+ */
+SparseVector *get_m_column(SparseMatrix *matr, SM_index_t col);
+
+/*
+ * Return the entry's value from a sparse matrix (or zero if there is none).
  * If row and column entries differ, set an error message and return ERR_MVAL.
  */
 SM_value_t get_m_entry(SparseMatrix *matr, SM_index_t row, SM_index_t col);
 
 /*
  * Remove entry given by its indices from a sparse matrix.
- * Return the value of the entry deleted (or 0 if there is none).
+ * Return the value of the entry deleted (or zero if there is none).
  * If row and column entries differ, set an error message and return ERR_MVAL.
  */
 SM_value_t remove_m_entry(SparseMatrix *matr, SM_index_t row, SM_index_t col);
 
 /*
- * Add entry given by its indices and value to a sparse matrix.
+ * Add entry given by its indices and value to a sparse matrix. The value
+ * is reduced first (modulo SM_PRIME or 2).
  * Return 0 on success and -1 otherwise.
  */
 int add_m_entry(SparseMatrix *matr,
@@ -122,16 +443,18 @@ int erase_m_column(SparseMatrix *matr, SM_index_t col, int do_del);
 
 /*
  * Add (with a scalar) two rows in a given sparse matrix.
- * Return the maximal absolute value of the new entries and -1 on failure.
+ * Return the maximal norm of the new entries and -1 on failure.
+ * If some new entry would be too big, return -2 and leave the matrix as is.
  */
-SM_value_t add_m_rows(SparseMatrix *matr,
+SM_coeff_t add_m_rows(SparseMatrix *matr,
 		SM_index_t row1, SM_index_t row2, SM_value_t scalar);
 
 /*
  * Add (with a scalar) two columns in a given sparse matrix.
- * Return the maximal absolute value of the new entries and -1 on failure.
+ * Return the maximal norm of the new entries and -1 on failure.
+ * If some new entry would be too big, return -2 and leave the matrix as is.
  */
-SM_value_t add_m_cols(SparseMatrix *matr,
+SM_coeff_t add_m_cols(SparseMatrix *matr,
 		SM_index_t col1, SM_index_t col2, SM_value_t scalar);
 
 /*
@@ -141,11 +464,74 @@ SM_value_t add_m_cols(SparseMatrix *matr,
 int init_s_matrix(SparseMatrix *matr,
 		SM_index_t n_rows, SM_index_t n_cols);
 
+/*
+ * Allocate memory for a new sparse matrix stored by rows only.
+ * Return 0 on success and -1 otherwise.
+ */
+int init_r_matrix(SparseMatrix *matr,
+		SM_index_t n_rows, SM_index_t n_cols);
+
 /*
  * Free the memory allocated for a sparse matrix.
  */
 void kill_s_matrix(SparseMatrix *matr);
 
+/*
+ * Count the entries in a sparse matrix, as well as its non-deleted rows and
+ * columns (if the pointers are not NULL). Used to monitor the matrix fill.
+ */
+long count_m_entries(SparseMatrix *matr,
+		SM_index_t *n_rows, SM_index_t *n_cols);
+
+/*
+ * Renumber the rows and columns of a sparse matrix, so that the row (column)
+ * number i becomes row_perm[i - 1] (col_perm[i - 1]). Both arrays must be
+ * permutations of 1, 2, ..., the number of rows (columns).
+ * Return 0 on success and -1 otherwise.
+ */
+int permute_m_matrix(SparseMatrix *matr,
+		SM_index_t *row_perm, SM_index_t *col_perm);
+
+#ifdef SM_DENSE
+/*
+ * Make a dense copy of the non-deleted part of a sparse matrix. If rows
+ * (or cols) is not NULL, only n_rows rows (or n_cols columns) whose indices
+ * are listed there are copied, and the entries of these rows must all lie
+ * in the columns copied.
+ * Return 0 on success, 1 if some entry is too big for a dense matrix,
+ * and -1 otherwise.
+ */
+int init_d_matrix(DenseMatrix *dmatr, SparseMatrix *matr,
+		SM_index_t *rows, SM_index_t n_rows,
+		SM_index_t *cols, SM_index_t n_cols);
+
+/*
+ * Find an invertible entry in a dense matrix, starting from the row *row.
+ * Store its position in *row and *col and return its value (or 0 if no
+ * such entry exists).
+ */
+SM_value_t find_d_unit(DenseMatrix *dmatr, SM_index_t *row, SM_index_t *col);
+
+/*
+ * Eliminate an invertible entry of a dense matrix by adding multiples of
+ * its column to all the other ones. Both the row and the column of the
+ * entry are zeroed out afterwards.
+ * Return 0 on success and -1 otherwise. If some new entry would be too big
+ * for a dense matrix, return 1 and leave the matrix as is.
+ */
+int eliminate_d_unit(DenseMatrix *dmatr, SM_index_t row, SM_index_t col);
+
+/*
+ * Free the memory allocated for a dense matrix.
+ */
+void kill_d_matrix(DenseMatrix *dmatr);
+#endif
+
+/*
+ * For testing only: print a (non-zero) value to stdout.
+ */
+void print_val(SM_value_t val);
+
 /*
  * For testing only: print the content of a sparse vector to stdout.
  * Deleted vectors are ignored.
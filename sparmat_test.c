@@ -0,0 +1,239 @@
+/*
+ *    sparmat_test.c --- tests for the sparse matrix library. The same matrix
+ *                       is eliminated in every ring of entries (see sparmat.h)
+ *                       and the outcome is compared with the known one. This
+ *                       file is compiled once for each ring, see "make check".
+ *
+ * Copyright (C) 2002--2018 Alexander Shumakovitch <Shurik@gwu.edu>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see COPYING.gz. If not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+
+#include "sparmat.h"
+
+/*
+ * The test matrix MATR is eliminated down to a block of size N - NUM_PIVOTS
+ * that has no units in it. Over the integers and Z[t]/(t^2=1), this block
+ * is 2x2 of rank 1 and its entries generate the ideal of TORSION (so that
+ * the cokernel is free of rank 1 plus the torsion). TORSION_GCD is the gcd
+ * of the entries over Z, and of their constant components over Z[t]/(t^2=1).
+ * Over Z/p and Z/2, nothing is left. The prime 3 is used over Z/p, so that
+ * 2 is a unit there.
+ */
+#define N 3
+
+#if defined(SM_RING_U)
+#  define RING_NAME "Z[t]/(t^2=1)"
+#  define U(a, b) {{(a), (b)}}
+static const SM_value_t MATR[N][N] = {
+	{U(0, 1), U(1, 0), U(0, 0)},
+	{U(1, 0), U(1, 2), U(1, 1)},
+	{U(0, 0), U(1, 1), U(1, 1)}
+};
+#  define NUM_PIVOTS 1
+#  define TORSION "1 + t"
+#  define TORSION_GCD 1
+#else
+static const SM_value_t MATR[N][N] = {
+	{1, 1, 0},
+	{1, 3, 2},
+	{0, 2, 2}
+};
+#  if defined(SM_RING_MODP)
+#    define RING_NAME "Z/3"
+#    define NUM_PIVOTS 2
+#  elif defined(SM_RING_GF2)
+#    define RING_NAME "Z/2"
+#    define NUM_PIVOTS 1
+#  else
+#    ifdef SM_RING_INT
+#      define RING_NAME "Z (int)"
+#    else
+#      define RING_NAME "Z (long)"
+#    endif
+#    define NUM_PIVOTS 1
+#    define TORSION "2"
+#    define TORSION_GCD 2
+#  endif
+#endif
+
+static int failed = 0;
+
+#define CHECK(cond, msg) \
+	if (!(cond)) { \
+		printf("  FAILED: %s\n", (msg)); \
+		failed = 1; \
+	}
+
+/*
+ * Build the test matrix.
+ * Return 0 on success and -1 otherwise.
+ */
+static int init_test_matrix(SparseMatrix *matr)
+{
+	SM_index_t row, col;
+
+	if (init_s_matrix(matr, N, N) == -1) return -1;
+
+	for (row = 1; row <= N; row++)
+		for (col = 1; col <= N; col++)
+			if (add_m_entry(matr, row, col,
+					MATR[row - 1][col - 1]) == -1)
+				return -1;
+
+	return 0;
+}
+
+/*
+ * Eliminate units of a sparse matrix one after another, the same way as
+ * sparreduce-U.c does: the pivot's row is cleared by adding multiples of
+ * the pivot's column, and then both are deleted.
+ * Return the number of units eliminated and -1 on failure.
+ */
+static int eliminate_units(SparseMatrix *matr)
+{
+	SM_index_t row, col, i, n_inc, indices[N];
+	SM_value_t val, coeff, values[N];
+	SparseVector *vec;
+	int n_pivots = 0, isfound = 1;
+
+	while (isfound) {
+		isfound = 0;
+
+		for (row = 1, vec = matr->rows; row <= N; row++, vec++) {
+			if (vec->num_entries == -1) continue;
+			if ((col = find_v_unit(vec, &val)) <= 0) continue;
+
+			/* the row changes as columns are added, copy it */
+			n_inc = vec->num_entries;
+			for (i = 0; i < n_inc; i++) {
+				indices[i] = vec->indices[i];
+				values[i] = get_v_value(vec, i);
+			}
+
+			coeff = neg_val(inv_val(val));
+			for (i = 0; i < n_inc; i++) {
+				if (indices[i] == col) continue;
+				if (add_m_cols(matr, indices[i], col,
+					mult_vals(values[i], coeff)) < 0)
+					return -1;
+			}
+
+			if (vec->num_entries != 1) {
+				ERR_MESSAGE = "eliminate_units: row is not cleared";
+				return -1;
+			}
+			if (erase_m_row(matr, row, 1) == -1 ||
+				erase_m_column(matr, col, 1) == -1)
+				return -1;
+
+			n_pivots++;
+			isfound = 1;
+		}
+	}
+
+	return n_pivots;
+}
+
+#ifdef TORSION
+/*
+ * Check the block left after the elimination: it is 2x2 of rank 1, and
+ * its entries generate the ideal of TORSION.
+ */
+static void check_block(SparseMatrix *matr)
+{
+	SM_index_t row, col, n_rows = 0, n_cols = 0, rows[N], cols[N];
+	SM_value_t block[2][2], det;
+	SM_coeff_t gcd = 0, a, b;
+	int j, k;
+
+	for (row = 1; row <= N; row++)
+		if (matr->rows[row - 1].num_entries != -1) rows[n_rows++] = row;
+	for (col = 1; col <= N; col++)
+		if (matr->columns[col - 1].num_entries != -1)
+			cols[n_cols++] = col;
+	CHECK(n_rows == 2 && n_cols == 2, "wrong size of the block left");
+	if (failed) return;
+
+	for (j = 0; j < 2; j++) {
+		for (k = 0; k < 2; k++) {
+			block[j][k] = get_m_entry(matr, rows[j], cols[k]);
+#ifdef SM_RING_U
+			/* a + b t lies in the ideal of 1 + t iff a = b */
+			CHECK(block[j][k].c[0] == block[j][k].c[1],
+				"entry is not divisible by 1 + t");
+			a = labs(block[j][k].c[0]);
+#else
+			a = ABSFUNC(block[j][k]);
+#endif
+			for (; a != 0; b = gcd % a, gcd = a, a = b);
+		}
+	}
+	CHECK(gcd == TORSION_GCD, "wrong ideal of entries");
+
+	det = mult_vals(block[0][0], block[1][1]);
+	add_mult_vals(det, neg_val(block[0][1]), block[1][0], &det);
+	CHECK(is_val_zero(det), "block is of rank 2");
+}
+#endif
+
+int main(void)
+{
+	SparseMatrix matr;
+	int n_pivots;
+#ifndef TORSION
+	SM_index_t row;
+#endif
+
+#ifdef SM_PRIME_RUNTIME
+	sm_prime = 3;
+#endif
+
+	printf("sparmat over %s:\n", RING_NAME);
+
+	if (init_test_matrix(&matr) == -1 || check_m_data(&matr) == -1) {
+		printf("  FAILED: %s\n", ERR_MESSAGE);
+		return 1;
+	}
+
+	if ((n_pivots = eliminate_units(&matr)) == -1) {
+		printf("  FAILED: %s\n", ERR_MESSAGE);
+		return 1;
+	}
+	CHECK(check_m_data(&matr) == 0, "matrix is corrupt");
+	CHECK(n_pivots == NUM_PIVOTS, "wrong number of units eliminated");
+
+#ifdef TORSION
+	if (!failed) check_block(&matr);
+	if (!failed)
+		printf("  units eliminated: %d, torsion: %s\n",
+						n_pivots, TORSION);
+#else
+	for (row = 1; row <= N; row++)
+		if (matr.rows[row - 1].num_entries > 0) break;
+	CHECK(row > N, "entries are left after the elimination");
+	if (!failed)
+		printf("  units eliminated: %d, nothing left\n", n_pivots);
+#endif
+
+	kill_s_matrix(&matr);
+
+	return failed;
+}
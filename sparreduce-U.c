@@ -24,7 +24,8 @@
  *
  *
  * To load from PARI/GP:
- *    install(reduce_s_complex_U, "LGGG", reduce_s_complex, "./sparreduce-U.so")
+ *    install(reduce_s_complex_U, "LGGGD0,L,", reduce_s_complex,
+ *							"./sparreduce-U.so")
  */
 
 #include <stdlib.h>
@@ -35,7 +36,9 @@
 #  define talker e_MISC
 #endif
 
-#include "sparmat-U.h"
+/* entries are elements of Z[t]/(t^2=1), see sparmat.h */
+#define SM_RING_U
+#include "sparmat.h"
 
 /* print some reduction statistic */
 // #define PRINT_REDSTAT
@@ -59,12 +62,52 @@ static SM_index_t *num_generators = NULL;	// current number of generators
 static GEN pari_matrices = NULL;		// matrices in Pari format
 static GEN num_entries = NULL;  		// number of matrix entries
 
+/*
+ * Specializations of the reduced complex at t = 1 and t = -1, that is, the
+ * even and odd Khovanov complexes. Their entries are kept as elements of
+ * Z[t]/(t^2=1) with zero t-component, so that they can be reduced further
+ * by exactly the same routines (and have more invertible entries to use).
+ */
+static SparseMatrix *spec_matrices[2] = {NULL, NULL};
+static SM_index_t *spec_ranks[2] = {NULL, NULL};
+
+static SM_index_t *row_indices = NULL;		// copy of the pivot row
+static SM_value_t *row_values = NULL;
+static SM_index_t row_length = 0;		// room in the arrays above
+
+static SparseMatrix *incl_matrices = NULL;	// gens left in the original basis
+static SparseMatrix *proj_matrices = NULL;	// and projections onto them
+
+/*
+ * Stop keeping track of the change of basis and free the memory it occupies.
+ */
+static void stop_tracking(void)
+{
+	SM_complex_t i;
+
+	if (incl_matrices != NULL) {
+		for (i = 0; i < cplx_size; i++)
+			kill_s_matrix(incl_matrices + i);
+		free(incl_matrices);
+	}
+	if (proj_matrices != NULL) {
+		for (i = 0; i < cplx_size; i++)
+			kill_s_matrix(proj_matrices + i);
+		free(proj_matrices);
+	}
+
+	incl_matrices = proj_matrices = NULL;
+}
+
 /*
  * Free all the memory allocated in the process.
  */
 static void cleanup(void)
 {
 	SM_complex_t i;
+	int spec;
+
+	stop_tracking();
 
 	if (cplx_matrices != NULL) {
 		for (i = 0; i < cplx_size - 1; i++)
@@ -72,8 +115,21 @@ static void cleanup(void)
 		free(cplx_matrices);
 	}
 
+	for (spec = 0; spec < 2; spec++) {
+		if (spec_matrices[spec] != NULL) {
+			for (i = 0; i < cplx_size - 1; i++)
+				kill_s_matrix(spec_matrices[spec] + i);
+			free(spec_matrices[spec]);
+		}
+		if (spec_ranks[spec] != NULL) free(spec_ranks[spec]);
+		spec_matrices[spec] = NULL;
+		spec_ranks[spec] = NULL;
+	}
+
 	if (cplx_group_ranks != NULL) free(cplx_group_ranks);
 	if (num_generators != NULL) free(num_generators);
+	if (row_indices != NULL) free(row_indices);
+	if (row_values != NULL) free(row_values);
 
 	cplx_size = 0;
 	first_group = 0;
@@ -83,6 +139,9 @@ static void cleanup(void)
 	num_generators = NULL;
 	pari_matrices = NULL;
 	num_entries = NULL;
+	row_indices = NULL;
+	row_values = NULL;
+	row_length = 0;
 }
 
 /*
@@ -94,26 +153,40 @@ static void bailout(void)
 	pari_err(talker, ERR_MESSAGE);
 }
 
+/*
+ * Allocate memory for an array of (empty) differential matrices.
+ */
+static SparseMatrix *malloc_matrices(void)
+{
+	SM_complex_t i;
+	SparseMatrix *matrices;
+
+	matrices = (SparseMatrix *)
+				malloc((cplx_size - 1) * sizeof(SparseMatrix));
+	if (matrices == NULL) return NULL;
+
+	for (i = 0; i < cplx_size - 1; i++) {
+		matrices[i].num_rows = 0;
+		matrices[i].num_cols = 0;
+		matrices[i].rows = NULL;
+		matrices[i].columns = NULL;
+		matrices[i].rows_only = 0;
+	}
+
+	return matrices;
+}
+
 /*
  * Allocate memory for main arrays.
  */
 static void malloc_arrays(SM_complex_t c_size)
 {
-	SM_complex_t i;
 	char *mem_error = "malloc_arrays: not enough memory";
 
 	cplx_size = c_size;
 
-	cplx_matrices = (SparseMatrix *)
-				malloc((cplx_size - 1) * sizeof(SparseMatrix));
 	/* check for problems early, to be able to kill cplx_matrices later */
-	if (cplx_matrices == NULL) ERR_BAIL(mem_error)
-	for (i = 0; i < cplx_size - 1; i++) {
-		cplx_matrices[i].num_rows = 0;
-		cplx_matrices[i].num_cols = 0;
-		cplx_matrices[i].rows = NULL;
-		cplx_matrices[i].columns = NULL;
-	}
+	if ((cplx_matrices = malloc_matrices()) == NULL) ERR_BAIL(mem_error)
 
 	cplx_group_ranks = (SM_index_t *) malloc(cplx_size * sizeof(SM_index_t));
 	num_generators = (SM_index_t *) malloc(cplx_size * sizeof(SM_index_t));
@@ -131,10 +204,10 @@ static void malloc_arrays(SM_complex_t c_size)
  */
 static void print_inums(SM_complex_t group)
 {
-	SM_index_t i;
-	SM_value_t tmp;
+	SM_index_t i, j;
+	SM_coeff_t tmp;
+	SM_value_t val;
 	SparseVector *vec;
-	SparseEntry *eptr;
 
 	if (group < first_group || group > last_group) return;
 
@@ -147,10 +220,12 @@ static void print_inums(SM_complex_t group)
 
 	for (i = 0; i < cplx_group_ranks[group]; i++, vec++) {
 		tmp = 0;
-		for (eptr = vec -> entries; eptr != NULL; eptr = eptr->next)
-			tmp += eptr->value * eptr->value;
+		for (j = 0; j < vec -> num_entries; j++) {
+			val = get_v_value(vec, j);
+			tmp += val.c[0] * val.c[0] + val.c[1] * val.c[1];
+		}
 		if (vec -> num_entries == -1) tmp = -1;
-		printf("%d, ", tmp);
+		printf("%ld, ", tmp);
 	}
 	printf("]\n");
 }
@@ -187,7 +262,7 @@ static void assign_matrix(SparseMatrix *matr, GEN entries_list, long list_len)
 	long tmp_val;
 #endif
 	SM_index_t row, column;
-	SM_value_t value[2];
+	SM_value_t value;
 	int is_val_neg, is_odd_var;
 
 	if (typ(entries_list) != t_VECSMALL) bailout();
@@ -210,8 +285,8 @@ static void assign_matrix(SparseMatrix *matr, GEN entries_list, long list_len)
 		column = abs(column);
 		row = abs(row);
 #endif
-		value[0] = value[1] = 0;
-		value[is_odd_var] = is_val_neg ? -1 : 1;
+		value = SM_ZERO;
+		value.c[is_odd_var] = is_val_neg ? -1 : 1;
 
 		if (add_m_entry(matr, row, column, value) == -1) bailout();
 	}
@@ -223,6 +298,8 @@ static void init_diff_matrix(SM_complex_t matrix)
 {
 	/* only differentials between non-empty groups are interesting */
 	if (matrix < first_group || matrix >= last_group) return;
+	if (cplx_group_ranks[matrix] == 0 || cplx_group_ranks[matrix + 1] == 0)
+		return;
 
 #ifdef PRINT_DEBUG
 	printf("Initializing matrix number %d.", matrix);
@@ -240,18 +317,16 @@ static void init_diff_matrix(SM_complex_t matrix)
 }
 
 /*
- * Assign values to the main internal variables.
+ * Find the first and last non-empty chain groups.
+ * Return -1 if the complex is empty and 0 otherwise.
  */
-static int init_ranks(GEN c_ranks)
+static int find_group_range(void)
 {
 	SM_complex_t i;
 
 	first_group = last_group = -1;
 
 	for (i = 0; i < cplx_size; i++) {
-		num_generators[i] = cplx_group_ranks[i] =
-					(SM_index_t) itos((GEN) c_ranks[i + 1]);
-
 		if (cplx_group_ranks[i] > 0) {
 			if (first_group < 0) first_group = i;
 			last_group = i;
@@ -268,23 +343,73 @@ static int init_ranks(GEN c_ranks)
 	return 0;
 }
 
+/*
+ * Assign values to the main internal variables.
+ */
+static int init_ranks(GEN c_ranks)
+{
+	SM_complex_t i;
+
+	for (i = 0; i < cplx_size; i++)
+		num_generators[i] = cplx_group_ranks[i] =
+					(SM_index_t) itos((GEN) c_ranks[i + 1]);
+
+	return find_group_range();
+}
+
+/*
+ * Start keeping track of the change of basis. The inclusion of every chain
+ * group after the reduction into the original one, as well as the projection
+ * back, are the identity for now.
+ */
+static void init_tracking(void)
+{
+	SM_complex_t group;
+	SM_index_t i, rank;
+	SM_value_t one = SM_ZERO;
+
+	incl_matrices = (SparseMatrix *) calloc(cplx_size, sizeof(SparseMatrix));
+	proj_matrices = (SparseMatrix *) calloc(cplx_size, sizeof(SparseMatrix));
+	if (incl_matrices == NULL || proj_matrices == NULL)
+		ERR_BAIL("init_tracking: not enough memory")
+
+	/* the complex is empty */
+	if (first_group < 0) return;
+
+	one.c[0] = 1;
+	for (group = first_group; group <= last_group; group++) {
+		if ((rank = cplx_group_ranks[group]) == 0) continue;
+
+		if (init_s_matrix(incl_matrices + group, rank, rank) == -1 ||
+			init_s_matrix(proj_matrices + group, rank, rank) == -1)
+			bailout();
+
+		for (i = 1; i <= rank; i++)
+			if (add_m_entry(incl_matrices + group, i, i, one) == -1 ||
+				add_m_entry(proj_matrices + group, i, i, one)
+									== -1)
+				bailout();
+	}
+}
+
 /*
  * Translate a matrix in the internal format into a PARI's matrix.
+ * If num_parts is 1, only the constant (not the t-) component is translated.
  */
-static void matr2pari(SM_complex_t group, GEN pari_matr[2])
+static void matr2pari(SM_complex_t group, GEN pari_matr[2], int num_parts)
 {
 	SM_index_t i, j, row, col;
-	SM_value_t val[2];
+	SM_value_t val;
 	SparseMatrix *matr = cplx_matrices + group;
 	SparseVector *matr_cols = matr->columns, *matr_rows = matr->rows;
 	SM_index_t n_rows = num_generators[group + 1];
 	SM_index_t n_cols = num_generators[group];
 	SM_index_t n_m_rows = matr->num_rows, n_m_cols = matr->num_cols;
-	GEN pari_vec[2];
+	GEN pari_vec[2] = {NULL, NULL};
 	char *matr_error = "matr2pari: matrix is corrupt";
 
 	pari_matr[0] = cgetg(n_cols + 1, t_MAT);
-	pari_matr[1] = cgetg(n_cols + 1, t_MAT);
+	if (num_parts > 1) pari_matr[1] = cgetg(n_cols + 1, t_MAT);
 
 	for (i = 1, col = 1; i <= n_cols; i++, col++) {
 		while(matr_cols[col - 1].num_entries == -1 && col <= n_m_cols)
@@ -292,43 +417,108 @@ static void matr2pari(SM_complex_t group, GEN pari_matr[2])
 		if (col > n_m_cols) ERR_BAIL(matr_error)
 
 		pari_vec[0] = cgetg(n_rows + 1, t_COL);
-		pari_vec[1] = cgetg(n_rows + 1, t_COL);
+		if (num_parts > 1) pari_vec[1] = cgetg(n_rows + 1, t_COL);
 		for (j = 1, row = 1; j <= n_rows; j++, row++) {
 			while(matr_rows[row - 1].num_entries == -1 &&
 					row <= n_m_rows) row++;
 			if (row > n_m_rows) ERR_BAIL(matr_error)
 
 			/* remove_m_entry checks much more than get_m_entry */
-			if (remove_m_entry(matr, row, col, val) == -1)
-				bailout();
+			val = remove_m_entry(matr, row, col);
+			if (are_vals_equal(val, ERR_MVAL)) bailout();
 
-			pari_vec[0][j] = (long)stoi(val[0]);
-			pari_vec[1][j] = (long)stoi(val[1]);
+			pari_vec[0][j] = (long)stoi(val.c[0]);
+			if (num_parts > 1) pari_vec[1][j] = (long)stoi(val.c[1]);
 		}
 		pari_matr[0][i] = (long) pari_vec[0];
-		pari_matr[1][i] = (long) pari_vec[1];
+		if (num_parts > 1) pari_matr[1][i] = (long) pari_vec[1];
+	}
+}
+
+/*
+ * Translate the change of basis of a group into PARI's matrices (constant
+ * and t-components). Columns of incl express the generators left after the
+ * reduction in the original ones (so cycles of the reduced complex become
+ * cycles of the original one), while proj is the chain map projecting the
+ * original generators onto the ones left.
+ */
+static void basis2pari(SM_complex_t group, GEN incl[2], GEN proj[2])
+{
+	SM_index_t i, j, col;
+	SM_index_t rank = cplx_group_ranks[group];
+	SM_index_t n_gens = num_generators[group];
+	SM_value_t val;
+	SparseMatrix *incl_matr = incl_matrices + group;
+	SparseMatrix *proj_matr = proj_matrices + group;
+	GEN incl_vec[2];
+	int part;
+
+	for (part = 0; part < 2; part++) {
+		incl[part] = cgetg(n_gens + 1, t_MAT);
+		proj[part] = cgetg(rank + 1, t_MAT);
+		for (j = 1; j <= rank; j++)
+			proj[part][j] = (long) cgetg(n_gens + 1, t_COL);
+	}
+
+	for (i = 1, col = 1; i <= n_gens; i++, col++) {
+		while (col <= rank &&
+				incl_matr->columns[col - 1].num_entries == -1)
+			col++;
+		if (col > rank) ERR_BAIL("basis2pari: matrix is corrupt")
+
+		for (part = 0; part < 2; part++)
+			incl_vec[part] = cgetg(rank + 1, t_COL);
+		for (j = 1; j <= rank; j++) {
+			val = get_m_entry(incl_matr, j, col);
+			if (are_vals_equal(val, ERR_MVAL)) bailout();
+			for (part = 0; part < 2; part++)
+				incl_vec[part][j] = (long)stoi(val.c[part]);
+
+			val = get_m_entry(proj_matr, col, j);
+			if (are_vals_equal(val, ERR_MVAL)) bailout();
+			for (part = 0; part < 2; part++)
+				((GEN) proj[part][j])[i] =
+						(long)stoi(val.c[part]);
+		}
+		for (part = 0; part < 2; part++)
+			incl[part][i] = (long) incl_vec[part];
 	}
 }
 
 /*
  * Prepare the result to be sent back to PARI.
+ * If num_parts is 1, the t-components of the matrices are not returned.
+ * If the change of basis is tracked, it follows the matrices as four more
+ * components: the constant and t-components of the inclusions, and then
+ * of the projections (see basis2pari).
  */
-static GEN feed2pari()
+static GEN feed2pari(int num_parts)
 {
 	SM_complex_t i, group;
-	GEN main_vec = cgetg(4, t_VEC);
-	GEN pari_matr[2];
+	int part, is_tracked = (incl_matrices != NULL);
+	GEN main_vec = cgetg(num_parts + (is_tracked ? 6 : 2), t_VEC);
+	GEN pari_matr[2], incl_matr[2], proj_matr[2];
 	GEN numgen_vec = cgetg(cplx_size + 1, t_VEC);
-	GEN matrices_vec[] = {cgetg(cplx_size, t_VEC), cgetg(cplx_size, t_VEC)};
+	GEN matrices_vec[2], incl_vec[2], proj_vec[2];
 
 	for (i = 1; i <= cplx_size; i++) numgen_vec[i] = (long)gen_0;
 	main_vec[1] = (long) numgen_vec;
 
-	for (i = 1; i < cplx_size; i++) matrices_vec[0][i] = (long)gen_0;
-	main_vec[2] = (long) matrices_vec[0];
+	for (part = 0; part < num_parts; part++) {
+		matrices_vec[part] = cgetg(cplx_size, t_VEC);
+		for (i = 1; i < cplx_size; i++)
+			matrices_vec[part][i] = (long)gen_0;
+		main_vec[part + 2] = (long) matrices_vec[part];
+	}
 
-	for (i = 1; i < cplx_size; i++) matrices_vec[1][i] = (long)gen_0;
-	main_vec[3] = (long) matrices_vec[1];
+	for (part = 0; is_tracked && part < 2; part++) {
+		incl_vec[part] = cgetg(cplx_size + 1, t_VEC);
+		proj_vec[part] = cgetg(cplx_size + 1, t_VEC);
+		for (i = 1; i <= cplx_size; i++)
+			incl_vec[part][i] = proj_vec[part][i] = (long)gen_0;
+		main_vec[num_parts + part + 2] = (long) incl_vec[part];
+		main_vec[num_parts + part + 4] = (long) proj_vec[part];
+	}
 
 	if (first_group < 0) return main_vec;
 
@@ -337,15 +527,25 @@ static GEN feed2pari()
 		if (num_generators[group] == 0) continue;
 		numgen_vec[group + 1] = (long)stoi(num_generators[group]);
 
+		if (is_tracked) {
+			basis2pari(group, incl_matr, proj_matr);
+			for (part = 0; part < 2; part++) {
+				incl_vec[part][group + 1] =
+						(long)(incl_matr[part]);
+				proj_vec[part][group + 1] =
+						(long)(proj_matr[part]);
+			}
+		}
+
 		/* no matrices after the last group */
 		if (group == last_group) continue;
 
 		/* no matrices with zero size */
 		if (num_generators[group + 1] == 0) continue;
 
-		matr2pari(group, pari_matr);
-		matrices_vec[0][group + 1] = (long)(pari_matr[0]);
-		matrices_vec[1][group + 1] = (long)(pari_matr[1]);
+		matr2pari(group, pari_matr, num_parts);
+		for (part = 0; part < num_parts; part++)
+			matrices_vec[part][group + 1] = (long)(pari_matr[part]);
 	}
 
 	/*
@@ -362,17 +562,81 @@ static GEN feed2pari()
  */
 static void kill_gen(SM_complex_t group, SM_index_t gen_num)
 {
-	if (group > first_group)
+	/* matrices next to empty groups are never initialized */
+	if (group > first_group && cplx_matrices[group - 1].rows != NULL)
 		if (erase_m_row(cplx_matrices + group - 1, gen_num, 1) == -1)
 			bailout();
 
-	if (group < last_group)
+	if (group < last_group && cplx_matrices[group].rows != NULL)
 		if (erase_m_column(cplx_matrices + group, gen_num, 1) == -1)
 			bailout();
 
+	if (incl_matrices != NULL &&
+		(erase_m_column(incl_matrices + group, gen_num, 1) == -1 ||
+		erase_m_row(proj_matrices + group, gen_num, 1) == -1))
+		bailout();
+
 	num_generators[group]--;
 }
 
+/*
+ * Copy the entries of a row into row_indices and row_values.
+ */
+static void copy_row(SparseVector *row)
+{
+	SM_index_t i;
+
+	if (row->num_entries > row_length) {
+		if (row_indices != NULL) free(row_indices);
+		if (row_values != NULL) free(row_values);
+
+		row_length = 2 * row->num_entries;
+		row_indices = (SM_index_t *)
+				malloc(row_length * sizeof(SM_index_t));
+		row_values = (SM_value_t *)
+				malloc(row_length * sizeof(SM_value_t));
+		if (row_indices == NULL || row_values == NULL)
+			ERR_BAIL("copy_row: not enough memory")
+	}
+
+	for (i = 0; i < row->num_entries; i++) {
+		row_indices[i] = row->indices[i];
+		row_values[i] = get_v_value(row, i);
+	}
+}
+
+/*
+ * Apply an elimination done by eliminate_gens to the change of basis, just
+ * before the generators are killed. The generators of the previous group are
+ * corrected by multiples of inc_gen (row_indices and row_values hold the
+ * n_inc entries of the pivot's row), while the projection of gen is spread
+ * over the other generators hit by inc_gen (the column of inc_gen is left
+ * intact by the elimination). Here gen_coeff is already negated.
+ */
+static void track_pivot(SM_complex_t group, SM_index_t gen,
+		SM_index_t inc_gen, SM_value_t gen_coeff, SM_index_t n_inc)
+{
+	SparseVector *inc_column = cplx_matrices[group - 1].columns +
+								inc_gen - 1;
+	SM_index_t i;
+	SM_coeff_t res = 0;
+
+	for (i = 0; i < n_inc && res >= 0; i++) {
+		if (row_indices[i] == inc_gen) continue;
+		res = add_m_cols(incl_matrices + group - 1, row_indices[i],
+			inc_gen, mult_vals(row_values[i], gen_coeff));
+	}
+
+	for (i = 0; i < inc_column->num_entries && res >= 0; i++) {
+		if (inc_column->indices[i] == gen) continue;
+		res = add_m_rows(proj_matrices + group, inc_column->indices[i],
+			gen, mult_vals(get_v_value(inc_column, i), gen_coeff));
+	}
+
+	if (res == -1) bailout();
+	if (res == -2) ERR_BAIL("track_pivot: change of basis is too big")
+}
+
 /*
  * Eliminate as many generators as possible in a given group.
  * Return 1 if some elimination was done and 0 otherwise.
@@ -380,9 +644,9 @@ static void kill_gen(SM_complex_t group, SM_index_t gen_num)
  */
 static int eliminate_gens(SM_complex_t group, int do_short)
 {
-	SM_index_t elim_cnt = 0, gen, inc_gen;
-	SM_value_t gen_coeff[2], add_coeff[2];
-	SparseEntry *cur_entry, *next_entry;
+	SM_index_t elim_cnt = 0, gen, inc_gen, i, n_inc;
+	SM_value_t gen_coeff;
+	SM_coeff_t res;
 	int isfound = 0;
 
 	SparseVector *inum_vectors;
@@ -396,6 +660,9 @@ static int eliminate_gens(SM_complex_t group, int do_short)
 	if (group < last_group && cplx_matrices[group].rows == 0)
 		init_diff_matrix(group);
 
+	/* nothing to eliminate if either group is empty */
+	if (cplx_matrices[group - 1].rows == NULL) return 0;
+
 	/* searching for invertible entries across rows is for some reason
 	 * _much_ faster than down columns, especially when do_short is set */
 	inum_vectors = cplx_matrices[group - 1].rows;
@@ -404,37 +671,52 @@ static int eliminate_gens(SM_complex_t group, int do_short)
 		if (inum_vectors->num_entries == -1) continue; // already gone
 		if (do_short && (inum_vectors->num_entries > 2)) continue;
 
-		inc_gen = find_v_unit(inum_vectors, gen_coeff);
+		inc_gen = find_v_unit(inum_vectors, &gen_coeff);
 		/* should be impossible after the previous check */
 		// if (inc_gen == ERR_MVAL) bailout ();
 
 		if (inc_gen == 0) continue; // no invertible incidence numbers
 
-		elim_cnt++;
-		isfound = 1;
-
 		/* gen_coeff^2 == 1 and we need to use it for subtraction */
-		gen_coeff[0] = -gen_coeff[0];
-		gen_coeff[1] = -gen_coeff[1];
-
-		/* entries in this column are being erased as the elimination
-		 * is taking place, so a simple 'for' loop is not enough */
-		cur_entry = inum_vectors->entries;
-		while (cur_entry != NULL) {
-			/* the current entry is going to be erased,
-			 * so we need to remember where it is pointing to */
-			next_entry = cur_entry->next;
-			mult_Uvals(cur_entry->value, gen_coeff, add_coeff);
-			if (cur_entry->index != inc_gen) {
+		gen_coeff = neg_val(gen_coeff);
+
+		/* entries in this row are being erased as the elimination
+		 * is taking place, so we need to copy them first */
+		copy_row(inum_vectors);
+		n_inc = inum_vectors->num_entries;
+
+		for (i = 0; i < n_inc; i++) {
+			if (row_indices[i] == inc_gen) continue;
+
+			res = add_m_cols(cplx_matrices + group - 1,
+					row_indices[i], inc_gen,
+					mult_vals(row_values[i], gen_coeff));
+			if (res == -1) bailout();
+			if (res == -2) break;
+		}
+
+		if (i < n_inc) {
+			/* some entry became too big. The column inc_gen is
+			 * still intact, so the additions can be undone and
+			 * this pivot is left to PARI */
+			while (i-- > 0) {
+				if (row_indices[i] == inc_gen) continue;
+
 				if (add_m_cols(cplx_matrices + group - 1,
-					cur_entry->index, inc_gen, add_coeff) == -1)
+					row_indices[i], inc_gen, neg_val(mult_vals(
+					row_values[i], gen_coeff))) < 0)
 						bailout();
 			}
-			cur_entry = next_entry;
+			continue;
 		}
 
+		elim_cnt++;
+		isfound = 1;
+
 		/* a single entry should remain in this column by now ... */
 		if (inum_vectors->num_entries != 1) ERR_BAIL(gen_error);
+		if (incl_matrices != NULL)
+			track_pivot(group, gen, inc_gen, gen_coeff, n_inc);
 		kill_gen(group - 1, inc_gen);
 
 		/* ... and now it has to be gone too */
@@ -450,37 +732,13 @@ static int eliminate_gens(SM_complex_t group, int do_short)
 }
 
 /*
- * Reduce a chain complex with only free Abelian chain groups as far as
- * possible using a sequence of elementary collapses and merging of cell.
- *
- * Arguments are:
- *   size (length) of the complex probably without zero groups at the ends
- *   ranks of the chain groups
- *   matrices of chain differentials in the sparse format
- *   lengths of arrays representing the matrices
- *
- * The return value is a 2-component vector which contain
- *   ranks of the chain groups after the reduction
- *   matrices of chain differentials after the reduction
- *     (matrices of size 0 are substituted with 0 for better visualization)
+ * Eliminate as many generators as possible in all the non-empty groups.
  */
-GEN reduce_s_complex_U(long c_size, GEN c_ranks, GEN d_matrices, GEN matr_lengths)
+static void reduce_groups(void)
 {
-	GEN answer;
 	SM_complex_t group;
 	int cnt_short, cnt_full;
 
-	malloc_arrays((SM_complex_t) c_size);
-	pari_matrices = d_matrices;
-	num_entries = matr_lengths;
-
-	if (init_ranks(c_ranks) == -1) {
-		/* complex is empty */
-		answer = feed2pari();
-		cleanup();
-		return answer;
-	}
-
 #ifdef PRINT_REDSTAT
 	printf("\n   ");
 #endif
@@ -498,8 +756,169 @@ GEN reduce_s_complex_U(long c_size, GEN c_ranks, GEN d_matrices, GEN matr_length
 		printf("%d+%d;  ", cnt_short, cnt_full);
 #endif
 	}
+}
+
+/*
+ * Specialize the (reduced) complex at t = t_val and store the result in
+ * spec_matrices[spec] and spec_ranks[spec]. Deleted generators are dropped
+ * and the remaining ones are renumbered consecutively.
+ */
+static void specialize_complex(int spec, SM_coeff_t t_val)
+{
+	SM_complex_t group;
+	SM_index_t i, new_row, new_col, *row_map;
+	SM_index_t j;
+	SM_value_t value;
+	SparseMatrix *matr, *new_matr;
+	SparseVector *cur_col;
+	char *mem_error = "specialize_complex: not enough memory";
+	char *matr_error = "specialize_complex: matrix is corrupt";
+
+	if ((spec_matrices[spec] = malloc_matrices()) == NULL)
+		ERR_BAIL(mem_error)
+	spec_ranks[spec] = (SM_index_t *) malloc(cplx_size * sizeof(SM_index_t));
+	if (spec_ranks[spec] == NULL) ERR_BAIL(mem_error)
+
+	for (group = 0; group < cplx_size; group++)
+		spec_ranks[spec][group] = num_generators[group];
+
+	if (first_group < 0) return;
+
+	for (group = first_group; group < last_group; group++) {
+		/* no matrices with zero size */
+		if (num_generators[group] == 0 || num_generators[group + 1] == 0)
+			continue;
+
+		matr = cplx_matrices + group;
+		new_matr = spec_matrices[spec] + group;
+		if (init_s_matrix(new_matr, num_generators[group + 1],
+					num_generators[group]) == -1) bailout();
+
+		/* new indices of the surviving rows, 0 for the deleted ones */
+		row_map = (SM_index_t *)
+			malloc((matr->num_rows + 1) * sizeof(SM_index_t));
+		if (row_map == NULL) ERR_BAIL(mem_error)
+
+		for (i = 1, new_row = 0; i <= matr->num_rows; i++)
+			row_map[i] = (matr->rows[i - 1].num_entries == -1) ?
+								0 : ++new_row;
+
+		for (i = 1, new_col = 0; i <= matr->num_cols; i++) {
+			if (matr->columns[i - 1].num_entries == -1) continue;
+			new_col++;
+
+			cur_col = matr->columns + i - 1;
+			for (j = 0; j < cur_col->num_entries; j++) {
+				value = get_v_value(cur_col, j);
+				value.c[0] += t_val * value.c[1];
+				value.c[1] = 0;
+
+				new_row = row_map[cur_col->indices[j]];
+				if (new_row == 0) {
+					free(row_map);
+					ERR_BAIL(matr_error)
+				}
+				if (add_m_entry(new_matr, new_row, new_col, value)
+									== -1) {
+					free(row_map);
+					bailout();
+				}
+			}
+		}
+
+		free(row_map);
+	}
+}
+
+/*
+ * Replace the complex with its specialization spec, reduce it further, and
+ * prepare the result to be sent back to PARI.
+ */
+static GEN reduce_spec(int spec)
+{
+	SM_complex_t i;
+
+	for (i = 0; i < cplx_size - 1; i++)
+		kill_s_matrix(cplx_matrices + i);
+	free(cplx_matrices);
+
+	cplx_matrices = spec_matrices[spec];
+	spec_matrices[spec] = NULL;
+
+	for (i = 0; i < cplx_size; i++)
+		num_generators[i] = cplx_group_ranks[i] = spec_ranks[spec][i];
+
+	if (find_group_range() != -1) reduce_groups();
+
+	return feed2pari(1);
+}
+
+/*
+ * Reduce a chain complex with only free Abelian chain groups as far as
+ * possible using a sequence of elementary collapses and merging of cell.
+ *
+ * Arguments are:
+ *   size (length) of the complex probably without zero groups at the ends
+ *   ranks of the chain groups
+ *   matrices of chain differentials in the sparse format
+ *   lengths of arrays representing the matrices
+ *   whether to compute the even and odd specializations as well
+ *   whether to keep track of the change of basis (0 or 1)
+ *
+ * The return value is a 3-component vector which contain
+ *   ranks of the chain groups after the reduction
+ *   constant and t-components of the matrices of chain differentials
+ *     after the reduction
+ *     (matrices of size 0 are substituted with 0 for better visualization)
+ * If do_EO is set, two more components are added: the specializations of
+ * the reduced complex at t = 1 and t = -1 (that is, even and odd Khovanov
+ * complexes), each reduced further over Z and presented as a 2-component
+ * vector of ranks and matrices as above.
+ * If the change of basis is tracked, four more components follow (they are
+ * the last ones): constant and t-components of the generators left in terms
+ * of the original ones (as columns of a matrix for every group), and of the
+ * projections onto them. The specializations are not tracked.
+ *
+ * Eliminations that would produce entries not fitting into SM_coeff_t are
+ * skipped, so such pivots remain in the matrices returned.
+ */
+GEN reduce_s_complex_U(long c_size, GEN c_ranks, GEN d_matrices,
+				GEN matr_lengths, long do_EO, long track)
+{
+	GEN answer, U_answer;
+	int i, U_size, is_empty;
+
+	malloc_arrays((SM_complex_t) c_size);
+	pari_matrices = d_matrices;
+	num_entries = matr_lengths;
+
+	/* nothing to reduce if the complex is empty */
+	is_empty = (init_ranks(c_ranks) == -1);
+	if (track) init_tracking();
+	if (! is_empty) reduce_groups();
+
+	/* feed2pari empties the matrices, so specialize them first */
+	if (do_EO) {
+		specialize_complex(0, 1);
+		specialize_complex(1, -1);
+	}
+
+	U_answer = feed2pari(2);
+	if (! do_EO) {
+		cleanup();
+		return U_answer;
+	}
+
+	/* generators of the specializations are numbered differently */
+	stop_tracking();
+
+	U_size = lg(U_answer) - 1;
+	answer = cgetg(U_size + 3, t_VEC);
+	for (i = 1; i <= 3; i++) answer[i] = U_answer[i];
+	for (i = 4; i <= U_size; i++) answer[i + 2] = U_answer[i];
+	answer[4] = (long) reduce_spec(0);
+	answer[5] = (long) reduce_spec(1);
 
-	answer = feed2pari();
 	cleanup();
 	return answer;
 }
@@ -24,11 +24,34 @@
  *
  *
  * To load from PARI/GP:
- *    install(reduce_s_complex, "LGGG", reduce_s_complex, "./sparreduce.so")
+ *    install(reduce_s_complex, "LGGGD0,L,D0,L,D\"\",s,D0,L,D\"\",s,D0,L,",
+ *				reduce_s_complex, "./sparreduce.so")
+ *    install(resume_s_complex, "sD0,L,", resume_s_complex, "./sparreduce.so")
+ *    install(save_red_state, "vsG", save_red_state, "./sparreduce.so")
+ *    install(load_red_state, "s", load_red_state, "./sparreduce.so")
+ *    install(remove_checkpoint, "vs", remove_checkpoint, "./sparreduce.so")
+ *    install(spill_matrix, "LsG", spill_matrix, "./sparreduce.so")
+ *    install(unspill_matrices, "vs", unspill_matrices, "./sparreduce.so")
+ *    install(spill_file_name, "sL", spill_file_name, "./sparreduce.so")
+ *    install(compress_matrix, "G", compress_matrix, "./sparreduce.so")
+ *    install(start_s_complex, "vLGGGD0,L,D0,L,D\"\",s,D0,L,",
+ *				start_s_complex, "./sparreduce.so")
+ *    install(poll_s_complex, "", poll_s_complex, "./sparreduce.so")
+ *    install(wait_s_complex, "", wait_s_complex, "./sparreduce.so")
+ *    install(cancel_s_complex, "v", cancel_s_complex, "./sparreduce.so")
  */
 
 #include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
 #include <limits.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 #include <pari/pari.h>
 
 #if PARI_VERSION_CODE > PARI_VERSION(2,7,0)
@@ -43,8 +66,85 @@
 /* print some debugging messages */
 // #define PRINT_DEBUG
 
+/* switch to the dense elimination once the fill of a differential matrix
+ * exceeds DENSE_FILL, provided that the number of its (non-deleted) entries
+ * is between DENSE_MIN_SIZE and DENSE_MAX_SIZE; comment out DENSE_FILL to
+ * stay with the sparse elimination all the way */
+#define DENSE_FILL 0.25
+#define DENSE_MIN_SIZE 4096L
+#define DENSE_MAX_SIZE (1L << 24)
+
+/* store the differential matrices with at least ROWS_ONLY_MIN entries by
+ * rows only, keeping just the (lazily updated) lists of rows for their
+ * columns instead of their values; comment out to always store both */
+#define ROWS_ONLY_MIN 1000000L
+
+/* reduce connected components of the complex (generators connected by
+ * non-zero incidence numbers) one by one, smaller ones first, instead of
+ * going through all the generators of a group at once; comment out to
+ * disable */
+#define SPLIT_COMPONENTS
+
+/* eliminate non-conflicting pivots of a group in ELIM_THREADS threads at
+ * once, provided that the group has at least THREADS_MIN_GENS generators
+ * to consider and its matrix is not stored by rows only (see ROWS_ONLY_MIN);
+ * comment out ELIM_THREADS to use a single thread only */
+#define ELIM_THREADS 4
+#define THREADS_MIN_GENS 1024
+
+/* send each differential matrix to PARI and free its internal copy as soon
+ * as the group by group sweep is done with it, so that only a few of them
+ * are kept at once (all of them are still loaded at the beginning if the
+ * generators are reordered or split into components); comment out to send
+ * all the matrices at the very end */
+#define EARLY_EXPORT
+
+/* allow a reduction to run in a background thread started by start_s_complex,
+ * while PARI/GP is busy with something else; comment out to disable */
+#define BACKGROUND_RED
+
+#if defined(ELIM_THREADS) || defined(BACKGROUND_RED)
+#  include <pthread.h>
+#endif
+
 #define ERR_BAIL(msg) { ERR_MESSAGE = (msg); bailout(); }
 
+/* orderings of generators that can be applied before the reduction: keep
+ * the original one, order by (static) minimum degree, or use the reverse
+ * Cuthill-McKee ordering of the whole complex */
+#define ORDER_NONE 0
+#define ORDER_MINDEG 1
+#define ORDER_RCM 2
+
+/* precision needed for the entries of a differential matrix: they fit into
+ * a dense matrix, they need the full SM_value_t, or some of them would not
+ * fit even there, so the corresponding pivots are left for PARI to finish
+ * with its multiprecision integers */
+#define PREC_DENSE 0
+#define PREC_LONG 1
+#define PREC_PARI 2
+
+/* order in which pivots are eliminated: sweep through the groups one by one
+ * exhausting each of them, or keep a single queue of pivots from all the
+ * differentials and always take the one with the smallest estimated fill-in
+ * (the dense and multithreaded eliminations are not used in the latter) */
+#define SCHED_SWEEP 0
+#define SCHED_QUEUE 1
+
+/* header of a checkpoint file written by save_checkpoint: the magic number,
+ * the version of the format, and the size of a long (the rest of the file
+ * consists of longs), each stored as a 4-byte number */
+#define CKPT_MAGIC 0x4b686f43U
+#define CKPT_VERSION 1U
+
+/* states of a reduction in the background, as reported by poll_s_complex:
+ * there is none, it's running, it's finished (or cancelled), or it's stopped
+ * by an error */
+#define BG_NONE 0
+#define BG_RUNNING 1
+#define BG_FINISHED 2
+#define BG_FAILED 3
+
 /*
  * Type for complex sizes. 4 bytes (i.e. up to 2^32) is enough.
  */
@@ -58,6 +158,102 @@ static SM_index_t *cplx_group_ranks = NULL;	// ranks of the chain groups
 static SM_index_t *num_generators = NULL;	// current number of generators
 static GEN pari_matrices = NULL;		// matrices in Pari format
 static GEN num_entries = NULL;  		// number of matrix entries
+static DenseMatrix dense_matr = {0, 0, NULL, NULL, NULL, 0};
+static SM_index_t *dense_elims = NULL;		// pairs of eliminated gens
+static SM_index_t *row_indices = NULL;		// copy of the pivot row
+static SM_value_t *row_values = NULL;
+static SM_index_t row_length = 0;		// room in the arrays above
+static char *matr_precision = NULL;		// precision of the matrices
+static SM_index_t *gen_offsets = NULL;		// global numbering of gens
+static SM_index_t *gen_perm = NULL;		// new numbers of the gens
+static SM_index_t *comp_gens = NULL;		// gens sorted by components
+static SM_index_t *comp_starts = NULL;		// where components start there
+static SM_index_t num_comps = 0;		// number of components
+static SM_index_t *dense_rows = NULL;		// part of a matrix to be
+static SM_index_t *dense_cols = NULL;		// made dense
+static SM_complex_t *comp_spans = NULL;		// groups spanned by components
+static GEN result_vec = NULL;			// answer to be sent to PARI
+static long *spill_map = NULL;			// file with spilled matrices
+static size_t spill_size = 0;			// mapped into memory
+static time_t deadline = 0;			// when to stop the reduction
+static int is_stopped = 0;			// and whether it's stopped
+static SM_complex_t sweep_group = 0;		// group the sweep is at
+static long start_gens = 0;			// generators when (re)started
+static FILE *ckpt_file = NULL;			// checkpoint being read/written
+static SparseMatrix *incl_matrices = NULL;	// gens left in the original basis
+static SparseMatrix *proj_matrices = NULL;	// and projections onto them
+static int bg_active = 0;			// reduction is in the background
+
+#ifdef BACKGROUND_RED
+static pthread_t bg_thread;			// thread doing the reduction
+static pthread_mutex_t bg_lock = PTHREAD_MUTEX_INITIALIZER; // guards below
+static int bg_status = BG_NONE;			// state of the thread
+static int bg_cancel = 0;			// whether to stop it
+static long bg_gens = 0;			// generators left by now
+static char *bg_error = NULL;			// error the thread stopped with
+static long bg_schedule = 0;			// schedule it uses
+#endif
+
+/*
+ * Candidate pivot in the queue: generator of a group with an invertible
+ * incidence number and the estimated fill-in caused by its elimination.
+ */
+typedef struct queued_gen {
+	long cost;
+	SM_complex_t group;
+	SM_index_t gen;
+} QueuedGen;
+
+static QueuedGen *pivot_queue = NULL;		// heap of candidate pivots
+static long queue_len = 0;			// its length and the room
+static long queue_room = 0;			// allocated for it
+static SM_index_t *col_indices = NULL;		// copy of the pivot column
+static SM_value_t *col_values = NULL;
+static SM_index_t col_length = 0;		// room in the arrays above
+
+#ifdef ELIM_THREADS
+/*
+ * Pivot to be eliminated by one of the threads. Its status is 0 if it was
+ * eliminated, 1 if some entry would become too big, and -1 on error.
+ */
+typedef struct pivot {
+	SM_index_t row, col;			// where the pivot is
+	SM_value_t coeff;			// minus its value
+	int status;
+} Pivot;
+
+/*
+ * Work assigned to one of the threads: every step-th pivot starting from
+ * the first one. The changes in the number of entries and the biggest
+ * entry created are collected as well, together with the error the thread
+ * stopped with (if any), to be reported by the main thread.
+ */
+typedef struct worker {
+	SM_complex_t group;
+	SM_index_t first, step;
+	long n_entries;
+	SM_value_t max_entry;
+	char *error;
+} Worker;
+
+static Pivot *pivots = NULL;			// pivots to eliminate at once
+static SM_index_t num_pivots = 0;
+static char *row_marks = NULL;			// rows and columns touched
+static char *col_marks = NULL;			// by the pivots
+#endif
+
+#ifdef PRINT_REDSTAT
+static long cur_entries = 0;			// entries in all the matrices
+static long peak_entries = 0;			// and their maximal number
+static SM_value_t max_entry = 0;		// biggest entry ever created
+static long queue_elims = 0;			// pivots taken from the queue
+static long queue_requeues = 0;			// and re-queued ones
+
+#define COUNT_ENTRIES(num) { cur_entries += (num); \
+	if (cur_entries > peak_entries) peak_entries = cur_entries; }
+#else
+#define COUNT_ENTRIES(num)
+#endif
 
 /*
  * Free all the memory allocated in the process.
@@ -75,6 +271,39 @@ static void cleanup(void)
 	if (cplx_group_ranks != NULL) free(cplx_group_ranks);
 	if (num_generators != NULL) free(num_generators);
 
+	kill_d_matrix(&dense_matr);
+	if (dense_elims != NULL) free(dense_elims);
+	if (row_indices != NULL) free(row_indices);
+	if (row_values != NULL) free(row_values);
+	if (matr_precision != NULL) free(matr_precision);
+	if (gen_offsets != NULL) free(gen_offsets);
+	if (gen_perm != NULL) free(gen_perm);
+	if (comp_gens != NULL) free(comp_gens);
+	if (comp_starts != NULL) free(comp_starts);
+	if (dense_rows != NULL) free(dense_rows);
+	if (dense_cols != NULL) free(dense_cols);
+	if (comp_spans != NULL) free(comp_spans);
+	if (pivot_queue != NULL) free(pivot_queue);
+	if (col_indices != NULL) free(col_indices);
+	if (col_values != NULL) free(col_values);
+	if (spill_map != NULL) munmap(spill_map, spill_size);
+	if (ckpt_file != NULL) fclose(ckpt_file);
+	if (incl_matrices != NULL) {
+		for (i = 0; i < cplx_size; i++)
+			kill_s_matrix(incl_matrices + i);
+		free(incl_matrices);
+	}
+	if (proj_matrices != NULL) {
+		for (i = 0; i < cplx_size; i++)
+			kill_s_matrix(proj_matrices + i);
+		free(proj_matrices);
+	}
+#ifdef ELIM_THREADS
+	if (pivots != NULL) free(pivots);
+	if (row_marks != NULL) free(row_marks);
+	if (col_marks != NULL) free(col_marks);
+#endif
+
 	cplx_size = 0;
 	first_group = 0;
 	last_group = 0;
@@ -83,13 +312,69 @@ static void cleanup(void)
 	num_generators = NULL;
 	pari_matrices = NULL;
 	num_entries = NULL;
+	dense_elims = NULL;
+	row_indices = NULL;
+	row_values = NULL;
+	row_length = 0;
+	matr_precision = NULL;
+	gen_offsets = NULL;
+	gen_perm = NULL;
+	comp_gens = NULL;
+	comp_starts = NULL;
+	num_comps = 0;
+	dense_rows = NULL;
+	dense_cols = NULL;
+	comp_spans = NULL;
+	result_vec = NULL;
+	pivot_queue = NULL;
+	queue_len = queue_room = 0;
+	col_indices = NULL;
+	col_values = NULL;
+	col_length = 0;
+	spill_map = NULL;
+	spill_size = 0;
+	deadline = 0;
+	is_stopped = 0;
+	sweep_group = 0;
+	start_gens = 0;
+	ckpt_file = NULL;
+	incl_matrices = proj_matrices = NULL;
+	bg_active = 0;
+#ifdef BACKGROUND_RED
+	bg_status = BG_NONE;
+	bg_cancel = 0;
+	bg_gens = 0;
+	bg_error = NULL;
+	bg_schedule = 0;
+#endif
+#ifdef ELIM_THREADS
+	pivots = NULL;
+	num_pivots = 0;
+	row_marks = col_marks = NULL;
+#endif
+#ifdef PRINT_REDSTAT
+	cur_entries = peak_entries = 0;
+	max_entry = 0;
+	queue_elims = queue_requeues = 0;
+#endif
 }
 
 /*
- * Bailout on error.
+ * Bailout on error. The background thread leaves the cleanup and reporting
+ * the error to wait_s_complex.
  */
 static void bailout(void)
 {
+#ifdef BACKGROUND_RED
+	if (bg_active) {
+		pthread_mutex_lock(&bg_lock);
+		bg_status = BG_FAILED;
+		bg_error = ERR_MESSAGE;
+		pthread_mutex_unlock(&bg_lock);
+		pthread_exit(NULL);
+	}
+#endif
+
 	cleanup();
 	pari_err(talker, ERR_MESSAGE);
 }
@@ -113,11 +398,14 @@ static void malloc_arrays(SM_complex_t c_size)
 		cplx_matrices[i].num_cols = 0;
 		cplx_matrices[i].rows = NULL;
 		cplx_matrices[i].columns = NULL;
+		cplx_matrices[i].rows_only = 0;
 	}
 
 	cplx_group_ranks = (SM_index_t *) malloc(cplx_size * sizeof(SM_index_t));
 	num_generators = (SM_index_t *) malloc(cplx_size * sizeof(SM_index_t));
-	if (cplx_group_ranks == NULL || num_generators == NULL)
+	matr_precision = (char *) calloc(cplx_size, sizeof(char));
+	if (cplx_group_ranks == NULL || num_generators == NULL ||
+			matr_precision == NULL)
 		ERR_BAIL(mem_error)
 }
 
@@ -129,10 +417,9 @@ static void malloc_arrays(SM_complex_t c_size)
  */
 static void print_inums(SM_complex_t group)
 {
-	SM_index_t i;
+	SM_index_t i, j;
 	SM_value_t tmp;
 	SparseVector *vec;
-	SparseEntry *eptr;
 
 	if (group < first_group || group > last_group) return;
 
@@ -145,10 +432,10 @@ static void print_inums(SM_complex_t group)
 
 	for (i = 0; i < cplx_group_ranks[group]; i++, vec++) {
 		tmp = 0;
-		for (eptr = vec -> entries; eptr != NULL; eptr = eptr->next)
-			tmp += eptr->value * eptr->value;
+		for (j = 0; j < vec -> num_entries; j++)
+			tmp += get_v_value(vec, j) * get_v_value(vec, j);
 		if (vec -> num_entries == -1) tmp = -1;
-		printf("%d, ", tmp);
+		printf("%ld, ", tmp);
 	}
 	printf("]\n");
 }
@@ -167,53 +454,186 @@ static void print_all_inums(void)
 
 #endif // #ifdef PRINT_DEBUG
 
+/*
+ * Read an entry of a matrix in the packed format (see assign_matrix), store
+ * its row and column in *row and *column, and return its value. Advance
+ * the pointer past the entry.
+ */
+static inline SM_value_t unpack_entry(GEN *GEN_ptr,
+				SM_index_t *row, SM_index_t *column)
+{
+#ifdef LONG_IS_64BIT
+	long tmp_val = (long) *((*GEN_ptr)++);
+	SM_value_t value = 1;
+
+	if (tmp_val < 0) {
+		tmp_val = -tmp_val;
+		value = -1;
+	}
+	*row = tmp_val >> 32;
+	*column = tmp_val & ((1L << 32) - 1);
+#else
+	SM_value_t value = 1;
+
+	*row = (SM_index_t) *((*GEN_ptr)++);
+	*column = (SM_index_t) *((*GEN_ptr)++);
+	if (*column < 0) {
+		*column = -*column;
+		value = -1;
+	}
+#endif
+
+	return value;
+}
+
+/*
+ * Number of words a single entry occupies in the packed format.
+ */
+#ifdef LONG_IS_64BIT
+#  define PACKED_WORDS 1
+#else
+#  define PACKED_WORDS 2
+#endif
+
+/*
+ * Read an unsigned number in the LEB128 encoding (7 bits per byte, lower ones
+ * first, the highest bit is set in all the bytes but the last one) and advance
+ * the pointer past it. Return -1 if the number doesn't end before end or is
+ * too big for a long.
+ */
+static inline long read_varint(unsigned char **ptr, unsigned char *end)
+{
+	unsigned long num = 0;
+	int shift = 0;
+
+	do {
+		if (*ptr >= end || shift > 8 * (int) sizeof(long) - 8) return -1;
+		num |= (unsigned long) (**ptr & 0x7f) << shift;
+		shift += 7;
+	} while (*((*ptr)++) & 0x80);
+
+	return (num > LONG_MAX) ? -1 : (long) num;
+}
+
+/*
+ * Write an unsigned number in the LEB128 encoding (see read_varint) and
+ * advance the pointer past it.
+ */
+static inline void write_varint(unsigned char **ptr, unsigned long num)
+{
+	while (num >= 0x80) {
+		*((*ptr)++) = (unsigned char) (num & 0x7f) | 0x80;
+		num >>= 7;
+	}
+	*((*ptr)++) = (unsigned char) num;
+}
+
+/*
+ * Add an entry of a matrix being translated into the internal format, unless
+ * it's a repetition of the previous one (see assign_matrix). The entry
+ * is kept in *prev_row, *prev_column, and *prev_value until a different one
+ * comes, which is when it's actually added. Once all the entries are
+ * passed, a last call with row 0 adds the one kept.
+ */
+static inline void add_packed_entry(SparseMatrix *matr, SM_index_t row,
+		SM_index_t column, SM_value_t value, SM_index_t *prev_row,
+		SM_index_t *prev_column, SM_value_t *prev_value)
+{
+	if (row == *prev_row && column == *prev_column) {
+		*prev_value += value;
+		return;
+	}
+
+	if (*prev_row != 0 && add_m_entry(matr, *prev_row, *prev_column,
+						*prev_value) == -1)
+		bailout();
+
+	*prev_row = row;
+	*prev_column = column;
+	*prev_value = value;
+}
+
+/*
+ * Translate a matrix compressed by compress_matrix into the internal format,
+ * decoding its entries one by one.
+ */
+static void assign_compressed(SparseMatrix *matr, GEN entries_list,
+							long list_len)
+{
+	unsigned char *ptr = (unsigned char *) (entries_list + 4);
+	unsigned char *end = ptr + entries_list[3];
+	long i, col_len = 0, delta;
+	SM_index_t row, column = 0, prev_row = 0, prev_column = 0;
+	SM_value_t prev_value = 0;
+	char *matr_error = "assign_compressed: input matrix is corrupt";
+
+	if (entries_list[2] != list_len || entries_list[3] < 0 ||
+			entries_list[3] > (lg(entries_list) - 4) * sizeof(long))
+		ERR_BAIL(matr_error)
+
+	for (i = 0; i < list_len; ) {
+		if ((delta = read_varint(&ptr, end)) == -1 ||
+			(col_len = read_varint(&ptr, end)) <= 0 ||
+			col_len > list_len - i || delta > INT_MAX - column)
+			ERR_BAIL(matr_error)
+		column += delta;
+
+		for (row = 0, i += col_len; col_len > 0; col_len--) {
+			if ((delta = read_varint(&ptr, end)) == -1 ||
+					delta / 2 > INT_MAX - row)
+				ERR_BAIL(matr_error)
+			row += delta / 2;
+
+			/* repetitions stay next to each other when sorted */
+			add_packed_entry(matr, row, column,
+					(delta % 2) ? -1 : 1,
+					&prev_row, &prev_column, &prev_value);
+		}
+	}
+	add_packed_entry(matr, 0, 0, 0, &prev_row, &prev_column, &prev_value);
+
+	if (ptr != end) ERR_BAIL(matr_error)
+}
+
 /*
  * Given a matrix in PARI's sparse format, translate it into the internal one.
- * Four formats are supported:
- *   standard: the entry is [row, column, value]
- *   reduced:  the entry is [row, value * column] with value = \pm1
- *   shrunk:   the entry is value * (row * 2^32 + column) with value = \pm1
- *             row and column are assumed to be not bigger than 2^31
- *   packed:   on a 64-bit architecture the same as shrunk
- *             on a 32-bit architecture every matrix entry occupies 2 places
- *             in the VECSMALL vector: ..., row, value * column, ...
- *             row and column are assumed to be not bigger than 2^31
+ * Five formats are supported:
+ *   standard:   the entry is [row, column, value]
+ *   reduced:    the entry is [row, value * column] with value = \pm1
+ *   shrunk:     the entry is value * (row * 2^32 + column) with value = \pm1
+ *               row and column are assumed to be not bigger than 2^31
+ *   packed:     on a 64-bit architecture the same as shrunk
+ *               on a 32-bit architecture every matrix entry occupies 2 places
+ *               in the VECSMALL vector: ..., row, value * column, ...
+ *               row and column are assumed to be not bigger than 2^31
+ *               an entry can be repeated right after itself, in which case
+ *               the values are summed up (this is how the Morse matching
+ *               passes bigger values)
+ *   compressed: the packed format compressed by compress_matrix, told apart
+ *               by the 0 in front
  */
 static void assign_matrix(SparseMatrix *matr, GEN entries_list, long list_len)
 {
 	GEN m_entry, GEN_ptr = entries_list + 1;
 	long i;
-#ifdef LONG_IS_64BIT
-	long tmp_val;
-#endif
-	SM_index_t row, column;
-	SM_value_t value;
+	SM_index_t row, column, prev_row = 0, prev_column = 0;
+	SM_value_t value, prev_value = 0;
 	char *matr_error = "assign_matrix: input matrix is corrupt";
 
 	/* packed format should be treated separately */
 	if (typ(entries_list) == t_VECSMALL) {
-		for (i = 0; i < list_len; i++, GEN_ptr++) {
-#ifdef LONG_IS_64BIT
-			tmp_val = (long) *GEN_ptr;
-			if (tmp_val < 0) {
-				tmp_val = -tmp_val;
-				value = -1;
-			} else
-				value = 1;
-			row = tmp_val >> 32;
-			column = tmp_val & ((1L << 32) - 1);
-#else
-			row = (SM_index_t) *(GEN_ptr++);
-			column = (SM_index_t) *GEN_ptr;
-			if (column < 0) {
-				column = -column;
-				value = -1;
-			} else
-				value = 1;
-#endif
-			if (add_m_entry(matr, row, column, value) == -1)
-				bailout();
+		if (list_len > 0 && entries_list[1] == 0) {
+			assign_compressed(matr, entries_list, list_len);
+			return;
+		}
+
+		for (i = 0; i < list_len; i++) {
+			value = unpack_entry(&GEN_ptr, &row, &column);
+			add_packed_entry(matr, row, column, value,
+					&prev_row, &prev_column, &prev_value);
 		}
+		add_packed_entry(matr, 0, 0, 0,
+					&prev_row, &prev_column, &prev_value);
 		return;
 	}
 
@@ -254,8 +674,56 @@ static void assign_matrix(SparseMatrix *matr, GEN entries_list, long list_len)
 	}
 }
 
+/*
+ * Map a file with matrices written by spill_matrix into memory (read-only).
+ */
+static void map_spill(char *file_name)
+{
+	struct stat file_stat;
+	int fd;
+
+	if ((fd = open(file_name, O_RDONLY)) == -1)
+		ERR_BAIL("map_spill: cannot open the file with matrices")
+
+	if (fstat(fd, &file_stat) == -1 || file_stat.st_size == 0) {
+		close(fd);
+		ERR_BAIL("map_spill: the file with matrices is empty")
+	}
+	spill_size = file_stat.st_size;
+
+	spill_map = (long *) mmap(NULL, spill_size, PROT_READ, MAP_PRIVATE,
+									fd, 0);
+	close(fd);
+	if (spill_map == MAP_FAILED) {
+		spill_map = NULL;
+		ERR_BAIL("map_spill: cannot map the file with matrices")
+	}
+}
+
+/*
+ * Return a matrix spilled by spill_matrix given its offset in the file.
+ * It's used right where it lies in the mapped file, without copying.
+ */
+static GEN spilled_matrix(long offset)
+{
+	long n_words = spill_size / sizeof(long);
+	GEN matr;
+	char *spill_error = "spilled_matrix: wrong offset of a matrix";
+
+	if (spill_map == NULL || offset < 0 || offset >= n_words)
+		ERR_BAIL(spill_error)
+
+	matr = (GEN) (spill_map + offset);
+	if (typ(matr) != t_VECSMALL || offset + lg(matr) > n_words)
+		ERR_BAIL(spill_error)
+
+	return matr;
+}
+
 static void init_diff_matrix(SM_complex_t matrix)
 {
+	GEN entries_list;
+
 	/* only differentials between non-empty groups are interesting */
 	if (matrix < first_group || matrix >= last_group) return;
 
@@ -263,10 +731,23 @@ static void init_diff_matrix(SM_complex_t matrix)
 	printf("Initializing matrix number %d.", matrix);
 #endif
 
+#ifdef ROWS_ONLY_MIN
+	if (itos((GEN) num_entries[matrix + 1]) >= ROWS_ONLY_MIN) {
+		if (init_r_matrix(cplx_matrices + matrix,
+				cplx_group_ranks[matrix + 1],
+				cplx_group_ranks[matrix]) == -1) bailout();
+	} else
+#endif
 	if (init_s_matrix(cplx_matrices + matrix, cplx_group_ranks[matrix + 1],
 				cplx_group_ranks[matrix]) == -1) bailout();
-	assign_matrix(cplx_matrices + matrix, (GEN) pari_matrices[matrix + 1],
+	/* a spilled matrix is only represented by its offset in the file */
+	entries_list = (GEN) pari_matrices[matrix + 1];
+	if (typ(entries_list) == t_INT)
+		entries_list = spilled_matrix(itos(entries_list));
+
+	assign_matrix(cplx_matrices + matrix, entries_list,
 					itos((GEN) num_entries[matrix + 1]));
+	COUNT_ENTRIES(count_m_entries(cplx_matrices + matrix, NULL, NULL))
 
 #ifdef PRINT_DEBUG
 	printf("Matrix number %d has ", matrix);
@@ -303,12 +784,55 @@ static int init_ranks(GEN c_ranks)
 	return 0;
 }
 
+/*
+ * Start keeping track of the change of basis. The inclusion of every chain
+ * group after the reduction into the original one, as well as the projection
+ * back, are the identity for now. Generators are numbered the same way as in
+ * the matrices of differentials (that is, after order_gens).
+ */
+static void init_tracking(void)
+{
+	SM_complex_t group;
+	SM_index_t i, rank;
+
+	incl_matrices = (SparseMatrix *) calloc(cplx_size, sizeof(SparseMatrix));
+	proj_matrices = (SparseMatrix *) calloc(cplx_size, sizeof(SparseMatrix));
+	if (incl_matrices == NULL || proj_matrices == NULL)
+		ERR_BAIL("init_tracking: not enough memory")
+
+	for (group = first_group; group <= last_group; group++) {
+		if ((rank = cplx_group_ranks[group]) == 0) continue;
+
+		if (init_s_matrix(incl_matrices + group, rank, rank) == -1 ||
+			init_s_matrix(proj_matrices + group, rank, rank) == -1)
+			bailout();
+
+		for (i = 1; i <= rank; i++)
+			if (add_m_entry(incl_matrices + group, i, i, 1) == -1 ||
+				add_m_entry(proj_matrices + group, i, i, 1)
+									== -1)
+				bailout();
+	}
+}
+
+/*
+ * Return the current number of a generator in the group given its original
+ * number (they differ if the generators were reordered by order_gens).
+ */
+static SM_index_t cur_gen_num(SM_complex_t group, SM_index_t gen)
+{
+	if (gen_perm == NULL) return gen;
+
+	return gen_perm[gen_offsets[group] + gen - 1];
+}
+
 /*
  * Translate a matrix in the internal format into a PARI's matrix.
+ * Rows and columns go in the original order of generators.
  */
 static GEN matr2pari(SM_complex_t group)
 {
-	SM_index_t i, j, row, col;
+	SM_index_t i, j, row, col, m_row, m_col;
 	SM_value_t val;
 	SparseMatrix *matr = cplx_matrices + group;
 	SparseVector *matr_cols = matr->columns, *matr_rows = matr->rows;
@@ -318,19 +842,22 @@ static GEN matr2pari(SM_complex_t group)
 	GEN pari_matr = cgetg(n_cols + 1, t_MAT), pari_vec;
 	char *matr_error = "matr2pari: matrix is corrupt";
 
-	for (i = 1, col = 1; i <= n_cols; i++, col++) {
-		while(matr_cols[col - 1].num_entries == -1 && col <= n_m_cols)
-			col++;
-		if (col > n_m_cols) ERR_BAIL(matr_error)
+	for (i = 1, col = 0; i <= n_cols; i++) {
+		do {
+			if (++col > n_m_cols) ERR_BAIL(matr_error)
+			m_col = cur_gen_num(group, col);
+		} while (matr_cols[m_col - 1].num_entries == -1);
 
 		pari_vec = cgetg(n_rows + 1, t_COL);
-		for (j = 1, row = 1; j <= n_rows; j++, row++) {
-			while(matr_rows[row - 1].num_entries == -1 &&
-					row <= n_m_rows) row++;
-			if (row > n_m_rows) ERR_BAIL(matr_error)
+		for (j = 1, row = 0; j <= n_rows; j++) {
+			do {
+				if (++row > n_m_rows) ERR_BAIL(matr_error)
+				m_row = cur_gen_num(group + 1, row);
+			} while (matr_rows[m_row - 1].num_entries == -1);
 
 			/* remove_m_entry checks much more than get_m_entry */
-			if ((val = remove_m_entry(matr, row, col)) == ERR_MVAL)
+			if ((val = remove_m_entry(matr, m_row, m_col))
+					== ERR_MVAL)
 				bailout();
 
 			pari_vec[j] = (long)stoi(val);
@@ -342,20 +869,108 @@ static GEN matr2pari(SM_complex_t group)
 }
 
 /*
- * Prepare the result to be sent back to PARI.
+ * Translate the change of basis of a group into PARI's matrices. Columns of
+ * *incl express the generators left after the reduction in the original
+ * ones (so cycles of the reduced complex become cycles of the original one),
+ * while *proj is the chain map projecting the original generators onto the
+ * ones left. Rows and columns go in the original order of generators.
  */
-static GEN feed2pari()
+static void basis2pari(SM_complex_t group, GEN *incl, GEN *proj)
+{
+	SM_index_t i, j, col, m_row, m_col;
+	SM_index_t rank = cplx_group_ranks[group];
+	SM_index_t n_gens = num_generators[group];
+	SM_value_t val;
+	SparseMatrix *incl_matr = incl_matrices + group;
+	SparseMatrix *proj_matr = proj_matrices + group;
+	GEN incl_vec;
+
+	*incl = cgetg(n_gens + 1, t_MAT);
+	*proj = cgetg(rank + 1, t_MAT);
+	for (j = 1; j <= rank; j++) (*proj)[j] = (long) cgetg(n_gens + 1, t_COL);
+
+	for (i = 1, col = 0; i <= n_gens; i++) {
+		do {
+			if (++col > rank)
+				ERR_BAIL("basis2pari: matrix is corrupt")
+			m_col = cur_gen_num(group, col);
+		} while (incl_matr->columns[m_col - 1].num_entries == -1);
+
+		incl_vec = cgetg(rank + 1, t_COL);
+		for (j = 1; j <= rank; j++) {
+			m_row = cur_gen_num(group, j);
+
+			if ((val = get_m_entry(incl_matr, m_row, m_col))
+					== ERR_MVAL)
+				bailout();
+			incl_vec[j] = (long)stoi(val);
+
+			if ((val = get_m_entry(proj_matr, m_col, m_row))
+					== ERR_MVAL)
+				bailout();
+			((GEN) (*proj)[j])[i] = (long)stoi(val);
+		}
+		(*incl)[i] = (long) incl_vec;
+	}
+}
+
+/*
+ * Allocate the vector to be sent back to PARI, filled with zeros. If the
+ * change of basis is tracked, there is room for it as well.
+ */
+static void init_result(int is_tracked)
 {
-	SM_complex_t i, group;
-	GEN main_vec = cgetg(3, t_VEC);
+	SM_complex_t i;
 	GEN matrices_vec = cgetg(cplx_size, t_VEC);
 	GEN numgen_vec = cgetg(cplx_size + 1, t_VEC);
+	GEN incl_vec, proj_vec;
+
+	result_vec = cgetg(is_tracked ? 5 : 3, t_VEC);
 
 	for (i = 1; i <= cplx_size; i++) numgen_vec[i] = (long)gen_0;
-	main_vec[1] = (long) numgen_vec;
+	result_vec[1] = (long) numgen_vec;
 
 	for (i = 1; i < cplx_size; i++) matrices_vec[i] = (long)gen_0;
-	main_vec[2] = (long) matrices_vec;
+	result_vec[2] = (long) matrices_vec;
+
+	if (! is_tracked) return;
+
+	incl_vec = cgetg(cplx_size + 1, t_VEC);
+	proj_vec = cgetg(cplx_size + 1, t_VEC);
+	for (i = 1; i <= cplx_size; i++)
+		incl_vec[i] = proj_vec[i] = (long)gen_0;
+	result_vec[3] = (long) incl_vec;
+	result_vec[4] = (long) proj_vec;
+}
+
+/*
+ * Translate a matrix that is not going to change anymore into PARI's format
+ * right away and free the memory it occupies.
+ */
+static void export_matrix(SM_complex_t group)
+{
+	GEN matrices_vec = (GEN) result_vec[2];
+	SparseMatrix *matr = cplx_matrices + group;
+
+	/* matrices of zero size stay 0, as in feed2pari */
+	if (num_generators[group] > 0 && num_generators[group + 1] > 0)
+		matrices_vec[group + 1] = (long) matr2pari(group);
+
+	kill_s_matrix(matr);
+	matr->rows = matr->columns = NULL;
+	matr->num_rows = matr->num_cols = 0;
+}
+
+/*
+ * Prepare the result to be sent back to PARI.
+ */
+static GEN feed2pari()
+{
+	SM_complex_t group;
+	GEN main_vec = result_vec;
+	GEN numgen_vec = (GEN) main_vec[1];
+	GEN matrices_vec = (GEN) main_vec[2];
+	GEN incl_matr, proj_matr;
 
 	if (first_group < 0) return main_vec;
 
@@ -364,12 +979,21 @@ static GEN feed2pari()
 		if (num_generators[group] == 0) continue;
 		numgen_vec[group + 1] = (long)stoi(num_generators[group]);
 
+		if (incl_matrices != NULL) {
+			basis2pari(group, &incl_matr, &proj_matr);
+			((GEN) main_vec[3])[group + 1] = (long) incl_matr;
+			((GEN) main_vec[4])[group + 1] = (long) proj_matr;
+		}
+
 		/* no matrices after the last group */
 		if (group == last_group) continue;
 
 		/* no matrices with zero size */
 		if (num_generators[group + 1] == 0) continue;
 
+		/* the matrix was already sent by export_matrix */
+		if (cplx_matrices[group].rows == NULL) continue;
+
 		matrices_vec[group + 1] = (long) matr2pari(group);
 	}
 
@@ -382,121 +1006,1732 @@ static GEN feed2pari()
 	return main_vec;
 }
 
+/*
+ * Return the total number of generators left in the complex.
+ */
+static long count_gens(void)
+{
+	SM_complex_t group;
+	long n_gens = 0;
+
+	for (group = 0; group < cplx_size; group++)
+		n_gens += num_generators[group];
+
+	return n_gens;
+}
+
+/*
+ * Check whether the time given for the reduction is over (it never is if
+ * there is no deadline). Once it's over, it stays so. The time is never
+ * over before at least something is eliminated, so that every run with
+ * a time budget makes some progress. A reduction in the background also
+ * reports its progress here and finds out whether it's cancelled.
+ */
+static int time_is_up(void)
+{
+#ifdef BACKGROUND_RED
+	if (bg_active) {
+		pthread_mutex_lock(&bg_lock);
+		if (bg_cancel) is_stopped = 1;
+		bg_gens = count_gens();
+		pthread_mutex_unlock(&bg_lock);
+	}
+#endif
+
+	if (deadline != 0 && ! is_stopped && time(NULL) >= deadline &&
+			count_gens() < start_gens)
+		is_stopped = 1;
+
+	return is_stopped;
+}
+
+/*
+ * Return a column of a matrix with its list of rows in order (see
+ * get_m_column). Its values are only there if the matrix is not stored
+ * by rows only.
+ */
+static SparseVector *matr_column(SparseMatrix *matr, SM_index_t col)
+{
+	SparseVector *vec;
+
+	if ((vec = get_m_column(matr, col)) == NULL) bailout();
+
+	return vec;
+}
+
 /*
  * Kill a generator gen_num in the group.
  */
 static void kill_gen(SM_complex_t group, SM_index_t gen_num)
 {
-	if (group > first_group)
+	if (group > first_group) {
+		COUNT_ENTRIES(- cplx_matrices[group - 1].rows[gen_num - 1]
+								.num_entries)
 		if (erase_m_row(cplx_matrices + group - 1, gen_num, 1) == -1)
 			bailout();
+	}
 
-	if (group < last_group)
+	if (group < last_group) {
+		COUNT_ENTRIES(- matr_column(cplx_matrices + group, gen_num)
+								->num_entries)
 		if (erase_m_column(cplx_matrices + group, gen_num, 1) == -1)
 			bailout();
+	}
+
+	if (incl_matrices != NULL &&
+		(erase_m_column(incl_matrices + group, gen_num, 1) == -1 ||
+		erase_m_row(proj_matrices + group, gen_num, 1) == -1))
+		bailout();
 
 	num_generators[group]--;
 }
 
 /*
- * Eliminate as many generators as possible in a given group.
- * Return 1 if some elimination was done and 0 otherwise.
- * If do_short is set, only consider generators with at most 2 incident ones.
+ * Add (with a scalar) two rows of a matrix and return the same as
+ * add_m_rows. Add the change in the number of entries to *n_entries and
+ * update *max_val with the biggest new entry. This is safe to be called
+ * from several threads at once, as long as they work with different
+ * rows and columns.
  */
-static int eliminate_gens(SM_complex_t group, int do_short)
+static SM_value_t add_rows_count(SparseMatrix *matr, SM_index_t row1,
+		SM_index_t row2, SM_value_t scalar,
+		long *n_entries, SM_value_t *max_val)
 {
-	SM_index_t elim_cnt = 0, gen, inc_gen;
-	SM_value_t gen_coeff;
-	SparseEntry *cur_entry, *next_entry;
-	int isfound = 0;
+	SM_index_t old_num = matr->rows[row1 - 1].num_entries;
+	SM_value_t res;
 
-	SparseVector *inum_vectors;
-	char *gen_error = "eliminate_gens: generator is not killed cleanly";
+	if ((res = add_m_rows(matr, row1, row2, scalar)) >= 0) {
+		*n_entries += matr->rows[row1 - 1].num_entries - old_num;
+		if (res > *max_val) *max_val = res;
+	}
 
-	/* check that the differential matrices are already initialized */
-	if (group > first_group + 1 && cplx_matrices[group - 2].rows == 0)
-		init_diff_matrix(group - 2);
-	if (group > first_group && cplx_matrices[group - 1].rows == 0)
-		init_diff_matrix(group - 1);
-	if (group < last_group && cplx_matrices[group].rows == 0)
-		init_diff_matrix(group);
+	return res;
+}
 
-	/* searching for invertible entries across rows is for some reason
-	 * _much_ faster than down columns, especially when do_short is set */
-	inum_vectors = cplx_matrices[group - 1].rows;
+/*
+ * Add (with a scalar) two rows of the differential matrix that ends
+ * in a given group. Return 0 on success and 1 if some entry would become
+ * too big, in which case the matrix is left as is.
+ */
+static int add_diff_rows(SM_complex_t group,
+		SM_index_t row1, SM_index_t row2, SM_value_t scalar)
+{
+	SM_value_t res, max_val = 0;
+	long n_entries = 0;
 
-	for (gen = 1; gen <= cplx_group_ranks[group]; gen++, inum_vectors++) {
-		if (inum_vectors->num_entries == -1) continue; // already gone
-		if (do_short && (inum_vectors->num_entries > 2)) continue;
+	res = add_rows_count(cplx_matrices + group - 1, row1, row2, scalar,
+						&n_entries, &max_val);
+	if (res == -1) bailout();
+	if (res == -2) return 1;
 
-		inc_gen = find_v_unit(inum_vectors, &gen_coeff);
-		/* should be impossible after the previous check */
-		// if (inc_gen == ERR_MVAL) bailout ();
+	COUNT_ENTRIES(n_entries)
+#ifdef PRINT_REDSTAT
+	if (max_val > max_entry) max_entry = max_val;
+#endif
 
-		if (inc_gen == 0) continue; // no invertible incidence numbers
+	return 0;
+}
 
-		elim_cnt++;
-		isfound = 1;
+/*
+ * Copy the entries of a row into row_indices and row_values.
+ */
+static void copy_row(SparseVector *row)
+{
+	SM_index_t i;
 
-		/* gen_coeff^2 == 1 and we need to use it for subtraction */
-		gen_coeff = -gen_coeff;
-
-		/* entries in this column are being erased as the elimination
-		 * is taking place, so a simple 'for' loop is not enough */
-		cur_entry = inum_vectors->entries;
-		while (cur_entry != NULL) {
-			/* the current entry is going to be erased,
-			 * so we need to remember where it is pointing to */
-			next_entry = cur_entry->next;
-			if (cur_entry->index != inc_gen) {
-				if (add_m_cols(cplx_matrices + group - 1,
-					cur_entry->index, inc_gen,
-					cur_entry->value * gen_coeff) == -1)
-						bailout();
-			}
-			cur_entry = next_entry;
-		}
+	if (row->num_entries > row_length) {
+		if (row_indices != NULL) free(row_indices);
+		if (row_values != NULL) free(row_values);
+
+		row_length = 2 * row->num_entries;
+		row_indices = (SM_index_t *)
+				malloc(row_length * sizeof(SM_index_t));
+		row_values = (SM_value_t *)
+				malloc(row_length * sizeof(SM_value_t));
+		if (row_indices == NULL || row_values == NULL)
+			ERR_BAIL("copy_row: not enough memory")
+	}
 
-		/* a single entry should remain in this column by now ... */
-		if (inum_vectors->num_entries != 1) ERR_BAIL(gen_error);
-		kill_gen(group - 1, inc_gen);
+	for (i = 0; i < row->num_entries; i++) {
+		row_indices[i] = row->indices[i];
+		row_values[i] = get_v_value(row, i);
+	}
+}
+
+/*
+ * Copy the entries of a column of the differential matrix that ends in
+ * a given group into col_indices and col_values. Return their number.
+ */
+static SM_index_t copy_column(SM_complex_t group, SM_index_t col)
+{
+	SparseMatrix *matr = cplx_matrices + group - 1;
+	SparseVector *vec = matr_column(matr, col);
+	SM_index_t i;
 
-		/* ... and now it has to be gone too */
-		if (inum_vectors->num_entries != 0) ERR_BAIL(gen_error);
-		kill_gen(group, gen);
+	if (vec->num_entries > col_length) {
+		if (col_indices != NULL) free(col_indices);
+		if (col_values != NULL) free(col_values);
+
+		col_length = 2 * vec->num_entries;
+		col_indices = (SM_index_t *)
+				malloc(col_length * sizeof(SM_index_t));
+		col_values = (SM_value_t *)
+				malloc(col_length * sizeof(SM_value_t));
+		if (col_indices == NULL || col_values == NULL)
+			ERR_BAIL("copy_column: not enough memory")
 	}
 
-#ifdef PRINT_REDSTAT
-	if (isfound) printf("%d | ", elim_cnt);
-#endif
+	/* the rows have the values even if the columns don't */
+	for (i = 0; i < vec->num_entries; i++) {
+		col_indices[i] = vec->indices[i];
+		if ((col_values[i] = get_m_entry(matr, col_indices[i], col))
+				== ERR_MVAL)
+			bailout();
+	}
 
-	return isfound;
+	return vec->num_entries;
 }
 
 /*
- * Reduce a chain complex with only free Abelian chain groups as far as
- * possible using a sequence of elementary collapses and merging of cell.
- *
+ * Number all the generators of the complex consecutively, group by group,
+ * and initialize all the differential matrices. Return the total number
+ * of generators.
+ */
+static SM_index_t number_gens(void)
+{
+	SM_complex_t group;
+	SM_index_t n_gens = 0;
+
+	/* all the matrices are needed at once */
+	for (group = first_group; group < last_group; group++)
+		if (cplx_matrices[group].rows == 0) init_diff_matrix(group);
+
+	if (gen_offsets == NULL) {
+		gen_offsets = (SM_index_t *)
+			malloc((cplx_size + 1) * sizeof(SM_index_t));
+		if (gen_offsets == NULL)
+			ERR_BAIL("number_gens: not enough memory")
+	}
+
+	for (group = 0; group < cplx_size; group++) {
+		gen_offsets[group] = n_gens;
+		n_gens += cplx_group_ranks[group];
+	}
+	gen_offsets[cplx_size] = n_gens;
+
+	return n_gens;
+}
+
+/*
+ * Return the group a generator with a given global number belongs to.
+ */
+static SM_complex_t gen_group(SM_index_t gen)
+{
+	SM_complex_t low = 0, high = cplx_size - 1, mid;
+
+	/* the last group with gen_offsets[group] <= gen */
+	while (low < high) {
+		mid = (low + high + 1) / 2;
+		if (gen_offsets[mid] <= gen)
+			low = mid;
+		else
+			high = mid - 1;
+	}
+
+	return low;
+}
+
+/*
+ * Return the number of non-zero incidence numbers of a generator with
+ * a given global number.
+ */
+static SM_index_t gen_degree(SM_index_t gen)
+{
+	SM_complex_t group = gen_group(gen);
+	SM_index_t ind = gen - gen_offsets[group], degree = 0;
+
+	if (group > first_group)
+		degree += cplx_matrices[group - 1].rows[ind].num_entries;
+	if (group < last_group)
+		degree += matr_column(cplx_matrices + group, ind + 1)
+								->num_entries;
+
+	return degree;
+}
+
+/*
+ * Generator together with a key to sort by.
+ */
+typedef struct keyed_gen {
+	SM_index_t key, gen;
+} KeyedGen;
+
+/*
+ * Compare two generators by their keys first (for qsort).
+ */
+static int compare_gens(const void *gen1, const void *gen2)
+{
+	KeyedGen *kgen1 = (KeyedGen *) gen1, *kgen2 = (KeyedGen *) gen2;
+
+	if (kgen1->key != kgen2->key)
+		return (kgen1->key > kgen2->key) - (kgen1->key < kgen2->key);
+
+	return (kgen1->gen > kgen2->gen) - (kgen1->gen < kgen2->gen);
+}
+
+/*
+ * Put the generators into the Cuthill-McKee order: go over the graph of
+ * the complex breadth first, visiting neighbors with smaller degrees first.
+ * Every connected component is started from a generator of minimal degree.
+ * The array seq must be sorted by degrees already, the new order replaces
+ * the old one there.
+ */
+static void order_cm(KeyedGen *seq, SM_index_t n_gens)
+{
+	SM_complex_t group;
+	SM_index_t i, j, k, head = 0, tail = 0, ind, gen;
+	KeyedGen *queue;
+	char *visited;
+	SparseVector *vec;
+
+	queue = (KeyedGen *) malloc(n_gens * sizeof(KeyedGen));
+	visited = (char *) calloc(n_gens, sizeof(char));
+	if (queue == NULL || visited == NULL) {
+		if (queue != NULL) free(queue);
+		if (visited != NULL) free(visited);
+		free(seq);
+		ERR_BAIL("order_cm: not enough memory")
+	}
+
+	for (i = 0; i < n_gens; i++) {
+		if (visited[seq[i].gen]) continue;
+		visited[seq[i].gen] = 1;
+		queue[tail++] = seq[i];
+
+		while (head < tail) {
+			gen = queue[head++].gen;
+			group = gen_group(gen);
+			ind = gen - gen_offsets[group];
+			k = tail;
+
+			/* neighbors in the previous and the next groups */
+			if (group > first_group) {
+				vec = cplx_matrices[group - 1].rows + ind;
+				for (j = 0; j < vec->num_entries; j++) {
+					gen = gen_offsets[group - 1] +
+							vec->indices[j] - 1;
+					if (visited[gen]) continue;
+					visited[gen] = 1;
+					queue[tail].gen = gen;
+					queue[tail++].key = gen_degree(gen);
+				}
+			}
+			if (group < last_group) {
+				vec = matr_column(cplx_matrices + group,
+								ind + 1);
+				for (j = 0; j < vec->num_entries; j++) {
+					gen = gen_offsets[group + 1] +
+							vec->indices[j] - 1;
+					if (visited[gen]) continue;
+					visited[gen] = 1;
+					queue[tail].gen = gen;
+					queue[tail++].key = gen_degree(gen);
+				}
+			}
+
+			qsort(queue + k, tail - k, sizeof(KeyedGen),
+								compare_gens);
+		}
+	}
+
+	for (i = 0; i < n_gens; i++) seq[i] = queue[i];
+
+	free(queue);
+	free(visited);
+}
+
+/*
+ * Renumber the generators of every group before the reduction, so that
+ * the ones that come first in a given order are tried first as pivots.
+ * The new number of every generator is stored in gen_perm to be able to
+ * restore the original order in feed2pari.
+ */
+static void order_gens(long order)
+{
+	SM_complex_t group;
+	SM_index_t i, n_gens, *next_num;
+	KeyedGen *seq, tmp_gen;
+	char *mem_error = "order_gens: not enough memory";
+
+	if (order != ORDER_MINDEG && order != ORDER_RCM) return;
+
+	n_gens = number_gens();
+
+	gen_perm = (SM_index_t *) malloc(n_gens * sizeof(SM_index_t));
+	if (gen_perm == NULL) ERR_BAIL(mem_error)
+
+	if ((seq = (KeyedGen *) malloc(n_gens * sizeof(KeyedGen))) == NULL)
+		ERR_BAIL(mem_error)
+
+	for (i = 0; i < n_gens; i++) {
+		seq[i].gen = i;
+		seq[i].key = gen_degree(i);
+	}
+	qsort(seq, n_gens, sizeof(KeyedGen), compare_gens);
+
+	if (order == ORDER_RCM) {
+		order_cm(seq, n_gens);
+
+		/* the reverse order reduces the fill-in better */
+		for (i = 0; i < n_gens / 2; i++) {
+			tmp_gen = seq[i];
+			seq[i] = seq[n_gens - 1 - i];
+			seq[n_gens - 1 - i] = tmp_gen;
+		}
+	}
+
+	/* generators get the next free number in their groups */
+	next_num = (SM_index_t *) calloc(cplx_size, sizeof(SM_index_t));
+	if (next_num == NULL) {
+		free(seq);
+		ERR_BAIL(mem_error)
+	}
+
+	for (i = 0; i < n_gens; i++) {
+		group = gen_group(seq[i].gen);
+		gen_perm[seq[i].gen] = ++next_num[group];
+	}
+
+	free(next_num);
+	free(seq);
+
+	for (group = first_group; group < last_group; group++)
+		if (permute_m_matrix(cplx_matrices + group,
+				gen_perm + gen_offsets[group + 1],
+				gen_perm + gen_offsets[group]) == -1)
+			bailout();
+}
+
+#ifdef SPLIT_COMPONENTS
+/*
+ * Find the root of a generator in the union-find forest, halving the path.
+ */
+static SM_index_t find_root(SM_index_t *parent, SM_index_t gen)
+{
+	while (parent[gen] != gen) {
+		parent[gen] = parent[parent[gen]];
+		gen = parent[gen];
+	}
+
+	return gen;
+}
+
+/*
+ * Split the generators of the complex into connected components, two of
+ * them being connected if the incidence number between them is not 0.
+ * Generators are numbered globally using gen_offsets. Components are sorted
+ * by size and stored in comp_gens, with the generators of each one sorted
+ * by their global numbers (that is, by group first). Components with a
+ * single generator are dropped, since there is nothing to eliminate there.
+ */
+static void find_components(void)
+{
+	SM_complex_t group;
+	SM_index_t i, j, n_gens, n_comp_gens = 0, size, pos, root1, root2;
+	SM_index_t *parent, *sizes, *counts;
+	SparseVector *vec;
+	char *mem_error = "find_components: not enough memory";
+
+	n_gens = number_gens();
+
+	parent = (SM_index_t *) malloc(n_gens * sizeof(SM_index_t));
+	sizes = (SM_index_t *) calloc(n_gens, sizeof(SM_index_t));
+	counts = (SM_index_t *) calloc(n_gens + 1, sizeof(SM_index_t));
+	if (parent == NULL || sizes == NULL || counts == NULL) {
+		if (parent != NULL) free(parent);
+		if (sizes != NULL) free(sizes);
+		if (counts != NULL) free(counts);
+		ERR_BAIL(mem_error)
+	}
+
+	for (i = 0; i < n_gens; i++) parent[i] = i;
+
+	/* join generators of each column with the ones from its rows */
+	for (group = first_group; group < last_group; group++) {
+		for (i = 0; i < cplx_matrices[group].num_cols; i++) {
+			vec = matr_column(cplx_matrices + group, i + 1);
+			for (j = 0; j < vec->num_entries; j++) {
+				root1 = find_root(parent, gen_offsets[group] + i);
+				root2 = find_root(parent,
+					gen_offsets[group + 1] +
+						vec->indices[j] - 1);
+				/* the smaller number becomes the root */
+				if (root1 < root2) parent[root2] = root1;
+				else if (root2 < root1) parent[root1] = root2;
+			}
+		}
+	}
+
+	for (i = 0; i < n_gens; i++) {
+		parent[i] = find_root(parent, i);
+		sizes[parent[i]]++;
+	}
+
+	/* the number of components of every size */
+	for (i = 0; i < n_gens; i++)
+		if (parent[i] == i && sizes[i] > 1) counts[sizes[i]]++;
+
+	num_comps = 0;
+	for (size = 2; size <= n_gens; size++) num_comps += counts[size];
+
+	comp_starts = (SM_index_t *)
+			malloc((num_comps + 1) * sizeof(SM_index_t));
+	if (comp_starts == NULL) {
+		free(parent);
+		free(sizes);
+		free(counts);
+		ERR_BAIL(mem_error)
+	}
+
+	/* components go by size, so counts become positions where the
+	 * components of the corresponding size start */
+	for (size = 2, j = 0; size <= n_gens; size++) {
+		pos = n_comp_gens;
+		for (i = 0; i < counts[size]; i++, j++) {
+			comp_starts[j] = n_comp_gens;
+			n_comp_gens += size;
+		}
+		counts[size] = pos;
+	}
+	comp_starts[num_comps] = n_comp_gens;
+
+	/* sizes of the roots become positions of the next generators */
+	for (i = 0; i < n_gens; i++) {
+		if (parent[i] != i) continue;
+		if (sizes[i] == 1) {
+			sizes[i] = -1;
+			continue;
+		}
+
+		size = sizes[i];
+		sizes[i] = counts[size];
+		counts[size] += size;
+	}
+
+	comp_gens = (SM_index_t *) malloc(n_comp_gens * sizeof(SM_index_t));
+	if (comp_gens == NULL && n_comp_gens > 0) {
+		free(parent);
+		free(sizes);
+		free(counts);
+		ERR_BAIL(mem_error)
+	}
+
+	for (i = 0; i < n_gens; i++)
+		if (sizes[parent[i]] != -1)
+			comp_gens[sizes[parent[i]]++] = i;
+
+	free(parent);
+	free(sizes);
+	free(counts);
+
+#ifdef PRINT_REDSTAT
+	printf("\n   %d components, the largest one has %d generators: ",
+		num_comps, num_comps > 0 ?
+		comp_starts[num_comps] - comp_starts[num_comps - 1] : 0);
+#endif
+}
+
+/*
+ * Return the first position in a sorted array of generators where the
+ * global number is at least gen.
+ */
+static SM_index_t *lower_bound(SM_index_t *first, SM_index_t *last,
+							SM_index_t gen)
+{
+	SM_index_t *mid;
+
+	while (first < last) {
+		mid = first + (last - first) / 2;
+		if (*mid < gen)
+			first = mid + 1;
+		else
+			last = mid;
+	}
+
+	return first;
+}
+
+/*
+ * Find the generators of a component that lie in a given group. Store their
+ * number in *n_gens and return a pointer to the first one in comp_gens.
+ */
+static SM_index_t *comp_range(SM_index_t comp, SM_complex_t group,
+							SM_index_t *n_gens)
+{
+	SM_index_t *first = comp_gens + comp_starts[comp];
+	SM_index_t *last = comp_gens + comp_starts[comp + 1];
+
+	first = lower_bound(first, last, gen_offsets[group]);
+	last = lower_bound(first, last, gen_offsets[group + 1]);
+	*n_gens = last - first;
+
+	return first;
+}
+/*
+ * Find the first and the last groups a given component spans.
+ */
+static void comp_groups(SM_index_t comp,
+				SM_complex_t *first, SM_complex_t *last)
+{
+	for (*first = first_group; gen_offsets[*first + 1] <=
+			comp_gens[comp_starts[comp]]; (*first)++);
+	for (*last = *first; gen_offsets[*last + 1] <=
+			comp_gens[comp_starts[comp + 1] - 1]; (*last)++);
+}
+#endif // #ifdef SPLIT_COMPONENTS
+
+#ifdef DENSE_FILL
+/*
+ * Check whether a differential matrix (or its part corresponding to a given
+ * component, if comp is not negative) is filled enough to be eliminated
+ * in the dense format.
+ */
+static int is_matr_dense(SM_complex_t matrix, SM_index_t comp)
+{
+	SM_index_t n_rows = 0, n_cols = 0;
+	long n_entries = 0, size;
+#ifdef SPLIT_COMPONENTS
+	SM_index_t i, n_gens, *gens;
+	SparseVector *vec;
+
+	if (comp >= 0) {
+		gens = comp_range(comp, matrix + 1, &n_gens);
+		for (i = 0; i < n_gens; i++) {
+			vec = cplx_matrices[matrix].rows +
+					gens[i] - gen_offsets[matrix + 1];
+			if (vec->num_entries == -1) continue;
+			n_entries += vec->num_entries;
+			n_rows++;
+		}
+
+		gens = comp_range(comp, matrix, &n_gens);
+		for (i = 0; i < n_gens; i++) {
+			vec = cplx_matrices[matrix].columns +
+					gens[i] - gen_offsets[matrix];
+			if (vec->num_entries != -1) n_cols++;
+		}
+	} else
+#endif
+	n_entries = count_m_entries(cplx_matrices + matrix, &n_rows, &n_cols);
+	size = (long) n_rows * n_cols;
+
+	if (size < DENSE_MIN_SIZE || size > DENSE_MAX_SIZE) return 0;
+
+	return n_entries > DENSE_FILL * size;
+}
+
+/*
+ * Eliminate as many generators as possible in a given group (or only in
+ * a given component, if comp is not negative) using a dense copy of the
+ * differential matrix, then put the result back into the sparse one.
+ * Unlike eliminate_gens, this is done exhaustively, so there is never
+ * a need to repeat the procedure and 0 is returned. If the entries become
+ * too big for the dense matrix, stop, mark the matrix as such, and return 1,
+ * so that the sparse elimination can take over.
+ */
+static int eliminate_dense(SM_complex_t group, SM_index_t comp)
+{
+	SparseMatrix *matr = cplx_matrices + group - 1;
+	SM_index_t i, j, row = 1, col, elim_cnt = 0;
+	SM_index_t n_rows = 0, n_cols = 0;
+	DM_value_t *vptr;
+	int res;
+#ifdef SPLIT_COMPONENTS
+	SM_index_t *gens;
+
+	if (comp >= 0) {
+		/* indices of the component's rows and columns */
+		gens = comp_range(comp, group, &n_rows);
+		dense_rows = (SM_index_t *) malloc(n_rows * sizeof(SM_index_t));
+		if (dense_rows == NULL)
+			ERR_BAIL("eliminate_dense: not enough memory")
+		for (i = 0; i < n_rows; i++)
+			dense_rows[i] = gens[i] - gen_offsets[group] + 1;
+
+		gens = comp_range(comp, group - 1, &n_cols);
+		dense_cols = (SM_index_t *) malloc(n_cols * sizeof(SM_index_t));
+		if (dense_cols == NULL)
+			ERR_BAIL("eliminate_dense: not enough memory")
+		for (i = 0; i < n_cols; i++)
+			dense_cols[i] = gens[i] - gen_offsets[group - 1] + 1;
+	}
+#endif
+
+	res = init_d_matrix(&dense_matr, matr, dense_rows, n_rows,
+							dense_cols, n_cols);
+#ifdef SPLIT_COMPONENTS
+	if (dense_rows != NULL) free(dense_rows);
+	if (dense_cols != NULL) free(dense_cols);
+	dense_rows = dense_cols = NULL;
+#endif
+	if (res != 0) {
+		if (res == -1) bailout();
+		matr_precision[group - 1] = PREC_LONG;
+		return 1;
+	}
+
+	/* no more than that many pairs can be eliminated */
+	dense_elims = (SM_index_t *) malloc(2 * sizeof(SM_index_t) *
+		(dense_matr.num_rows < dense_matr.num_cols ?
+			dense_matr.num_rows : dense_matr.num_cols));
+	if (dense_elims == NULL) ERR_BAIL("eliminate_dense: not enough memory")
+
+	while (find_d_unit(&dense_matr, &row, &col) != 0) {
+		if ((res = eliminate_d_unit(&dense_matr, row, col)) != 0) {
+			if (res == -1) bailout();
+			/* what is done so far is still valid */
+			matr_precision[group - 1] = PREC_LONG;
+			break;
+		}
+
+		dense_elims[2 * elim_cnt] = dense_matr.row_inds[row - 1];
+		dense_elims[2 * elim_cnt + 1] = dense_matr.col_inds[col - 1];
+		elim_cnt++;
+	}
+
+	if (elim_cnt > 0) {
+		/* empty the sparse matrix and kill eliminated generators */
+		for (i = 0; i < dense_matr.num_rows; i++) {
+			COUNT_ENTRIES(- matr->rows[dense_matr.row_inds[i] - 1]
+								.num_entries)
+			if (erase_m_row(matr, dense_matr.row_inds[i], 0) == -1)
+				bailout();
+		}
+
+		for (i = 0; i < elim_cnt; i++) {
+			kill_gen(group - 1, dense_elims[2 * i + 1]);
+			kill_gen(group, dense_elims[2 * i]);
+		}
+
+		/* going backwards, every new entry becomes the first one in
+		 * both its row and its column, which is the fastest */
+		for (i = dense_matr.num_rows; i > 0; i--) {
+			vptr = dense_matr.values +
+					(size_t) (i - 1) * dense_matr.num_cols;
+			for (j = dense_matr.num_cols; j > 0; j--) {
+				if (vptr[j - 1] == 0) continue;
+				if (add_m_entry(matr, dense_matr.row_inds[i - 1],
+					dense_matr.col_inds[j - 1],
+					vptr[j - 1]) == -1) bailout();
+				COUNT_ENTRIES(1)
+			}
+		}
+	}
+
+#ifdef PRINT_REDSTAT
+	if (elim_cnt > 0) printf("%d (dense) | ", elim_cnt);
+#endif
+
+	kill_d_matrix(&dense_matr);
+	free(dense_elims);
+	dense_elims = NULL;
+
+	return res;
+}
+#endif // #ifdef DENSE_FILL
+
+#ifdef ELIM_THREADS
+/*
+ * Eliminate the pivots assigned to a thread (see Worker). The column of every
+ * pivot is cleared by adding multiples of its row to the other ones, but
+ * the generators are not killed yet. If some entry would become too big,
+ * the additions are undone.
+ */
+static void *eliminate_pivots(void *arg)
+{
+	Worker *worker = (Worker *) arg;
+	SparseMatrix *matr = cplx_matrices + worker->group - 1;
+	SparseVector *col;
+	SM_index_t k, i, n_inc, length = 0, *indices = NULL, *new_inds;
+	SM_value_t res = 0, *values = NULL, *new_vals;
+	Pivot *pivot;
+
+	for (k = worker->first; k < num_pivots; k += worker->step) {
+		pivot = pivots + k;
+		/* its list of rows was put in order by eliminate_parallel */
+		col = matr->columns + pivot->col - 1;
+
+		/* this thread's own copy of the column */
+		if ((n_inc = col->num_entries) > length) {
+			length = 2 * n_inc;
+			new_inds = (SM_index_t *)
+				realloc(indices, length * sizeof(SM_index_t));
+			if (new_inds != NULL) indices = new_inds;
+			new_vals = (SM_value_t *)
+				realloc(values, length * sizeof(SM_value_t));
+			if (new_vals != NULL) values = new_vals;
+
+			if (new_inds == NULL || new_vals == NULL) {
+				worker->error =
+					"eliminate_pivots: not enough memory";
+				pivot->status = -1;
+				break;
+			}
+		}
+		for (i = 0; i < n_inc; i++) {
+			indices[i] = col->indices[i];
+			values[i] = get_m_entry(matr, indices[i], pivot->col);
+			if (values[i] == ERR_MVAL) break;
+		}
+		if (i < n_inc) {
+			pivot->status = -1;
+			break;
+		}
+
+		for (i = 0; i < n_inc; i++) {
+			if (indices[i] == pivot->row) continue;
+			res = add_rows_count(matr, indices[i], pivot->row,
+					values[i] * pivot->coeff,
+					&worker->n_entries, &worker->max_entry);
+			if (res < 0) break;
+		}
+
+		if (i == n_inc) {
+			pivot->status = 0;
+			continue;
+		}
+
+		if (res == -1) {
+			pivot->status = -1;
+			break;
+		}
+
+		/* the row pivot->row is still intact, so the additions can
+		 * be undone */
+		pivot->status = 1;
+		while (i-- > 0) {
+			if (indices[i] == pivot->row) continue;
+			if (add_rows_count(matr, indices[i], pivot->row,
+					- values[i] * pivot->coeff,
+					&worker->n_entries,
+					&worker->max_entry) < 0) {
+				pivot->status = -1;
+				break;
+			}
+		}
+		if (pivot->status == -1) break;
+	}
+
+	/* sparmat reports errors in this thread's own ERR_MESSAGE */
+	if (k < num_pivots && worker->error == NULL)
+		worker->error = ERR_MESSAGE;
+
+	if (indices != NULL) free(indices);
+	if (values != NULL) free(values);
+
+	return NULL;
+}
+
+/*
+ * Eliminate generators in a given group using several threads at once.
+ * Only the generators listed in gens (by their global numbers) are
+ * considered, or all of them if gens is NULL. First, a maximal set of
+ * invertible entries is chosen such that eliminating one of them doesn't
+ * touch the rows and columns changed by the others. Then these pivots are
+ * eliminated in parallel, and the generators are killed afterwards.
+ * Return 1 if some elimination was done and 0 otherwise.
+ */
+static int eliminate_parallel(SM_complex_t group,
+				SM_index_t *gens, SM_index_t n_gens)
+{
+	SparseMatrix *matr = cplx_matrices + group - 1;
+	SparseVector *row, *col;
+	SM_index_t k, i, gen, inc_gen, elim_cnt = 0;
+	SM_value_t gen_coeff;
+	pthread_t threads[ELIM_THREADS];
+	Worker workers[ELIM_THREADS];
+	int t, n_threads, is_started[ELIM_THREADS], conflict;
+	char *mem_error = "eliminate_parallel: not enough memory";
+	char *gen_error = "eliminate_parallel: generator is not killed cleanly";
+
+	row_marks = (char *) calloc(matr->num_rows, sizeof(char));
+	col_marks = (char *) calloc(matr->num_cols, sizeof(char));
+	pivots = (Pivot *) malloc(n_gens * sizeof(Pivot));
+	if (row_marks == NULL || col_marks == NULL || pivots == NULL)
+		ERR_BAIL(mem_error)
+
+	num_pivots = 0;
+	for (k = 0; k < n_gens; k++) {
+		gen = (gens == NULL) ? k + 1 : gens[k] - gen_offsets[group] + 1;
+		row = matr->rows + gen - 1;
+		if (row->num_entries <= 0) continue; // gone or nothing there
+
+		if ((inc_gen = find_v_unit(row, &gen_coeff)) == 0) continue;
+		col = matr_column(matr, inc_gen);
+
+		/* the columns changed are the ones in the pivot's row and
+		 * the rows changed are the ones in the pivot's column */
+		conflict = 0;
+		for (i = 0; i < row->num_entries && ! conflict; i++)
+			conflict = col_marks[row->indices[i] - 1];
+		for (i = 0; i < col->num_entries && ! conflict; i++)
+			conflict = row_marks[col->indices[i] - 1];
+		if (conflict) continue;
+
+		for (i = 0; i < row->num_entries; i++)
+			col_marks[row->indices[i] - 1] = 1;
+		for (i = 0; i < col->num_entries; i++)
+			row_marks[col->indices[i] - 1] = 1;
+
+		pivots[num_pivots].row = gen;
+		pivots[num_pivots].col = inc_gen;
+		/* gen_coeff^2 == 1 and we need to use it for subtraction */
+		pivots[num_pivots].coeff = -gen_coeff;
+		pivots[num_pivots++].status = -1;
+	}
+
+	free(row_marks);
+	free(col_marks);
+	row_marks = col_marks = NULL;
+
+	n_threads = (num_pivots < ELIM_THREADS) ? num_pivots : ELIM_THREADS;
+	for (t = 0; t < n_threads; t++) {
+		workers[t].group = group;
+		workers[t].first = t;
+		workers[t].step = n_threads;
+		workers[t].n_entries = 0;
+		workers[t].max_entry = 0;
+		workers[t].error = NULL;
+
+		is_started[t] = (pthread_create(threads + t, NULL,
+				eliminate_pivots, workers + t) == 0);
+		/* do the work here if no thread can be started */
+		if (! is_started[t]) eliminate_pivots(workers + t);
+	}
+
+	for (t = 0; t < n_threads; t++) {
+		if (is_started[t]) pthread_join(threads[t], NULL);
+		COUNT_ENTRIES(workers[t].n_entries)
+#ifdef PRINT_REDSTAT
+		if (workers[t].max_entry > max_entry)
+			max_entry = workers[t].max_entry;
+#endif
+	}
+
+	/* the first error of the threads is reported here */
+	for (t = 0; t < n_threads; t++)
+		if (workers[t].error != NULL) ERR_BAIL(workers[t].error)
+
+	for (k = 0; k < num_pivots; k++) {
+		if (pivots[k].status == -1)
+			ERR_BAIL("eliminate_parallel: a pivot is left behind")
+		if (pivots[k].status == 1) {
+			/* leave this pivot to PARI */
+			matr_precision[group - 1] = PREC_PARI;
+			continue;
+		}
+
+		/* the same as in eliminate_pivot */
+		if (matr_column(matr, pivots[k].col)->num_entries != 1)
+			ERR_BAIL(gen_error)
+		kill_gen(group - 1, pivots[k].col);
+		kill_gen(group, pivots[k].row);
+
+		elim_cnt++;
+	}
+
+	free(pivots);
+	pivots = NULL;
+	num_pivots = 0;
+
+#ifdef PRINT_REDSTAT
+	if (elim_cnt > 0) printf("%d (parallel) | ", elim_cnt);
+#endif
+
+	return elim_cnt > 0;
+}
+#endif // #ifdef ELIM_THREADS
+
+/*
+ * Apply an elimination done by eliminate_pivot to the change of basis, just
+ * before the generators are killed. The generators of the previous group are
+ * corrected by multiples of inc_gen (row_indices and row_values hold the
+ * n_inc entries of the pivot's row), while the projection of gen is spread
+ * over the other generators hit by inc_gen (col_indices and col_values hold
+ * the n_col entries of the pivot's column as they were before the
+ * elimination). Here gen_coeff is already negated.
+ */
+static void track_pivot(SM_complex_t group, SM_index_t gen,
+		SM_index_t inc_gen, SM_value_t gen_coeff,
+		SM_index_t n_inc, SM_index_t n_col)
+{
+	SM_index_t i;
+	SM_value_t res = 0;
+
+	for (i = 0; i < n_inc && res >= 0; i++) {
+		if (row_indices[i] == inc_gen) continue;
+		res = add_m_cols(incl_matrices + group - 1, row_indices[i],
+					inc_gen, row_values[i] * gen_coeff);
+	}
+
+	for (i = 0; i < n_col && res >= 0; i++) {
+		if (col_indices[i] == gen) continue;
+		res = add_m_rows(proj_matrices + group, col_indices[i], gen,
+					col_values[i] * gen_coeff);
+	}
+
+	if (res == -1) bailout();
+	if (res == -2) ERR_BAIL("track_pivot: change of basis is too big")
+}
+
+/*
+ * Eliminate a generator of a given group together with the generator inc_gen
+ * of the previous group, gen_coeff being the (invertible) incidence number
+ * between them. The other rows hit by inc_gen are cleared by adding multiples
+ * of the row of gen, so only the rows need to be changed, and col_indices
+ * holds them afterwards. Return 1 on success and 0 if some entry would become
+ * too big, in which case the matrices are left as is and the pivot is left
+ * to PARI.
+ */
+static int eliminate_pivot(SM_complex_t group, SM_index_t gen,
+				SM_index_t inc_gen, SM_value_t gen_coeff)
+{
+	SparseVector *inum_vectors = cplx_matrices[group - 1].rows + gen - 1;
+	SM_index_t i, n_inc, n_col;
+	char *gen_error = "eliminate_pivot: generator is not killed cleanly";
+
+	/* gen_coeff^2 == 1 and we need to use it for subtraction */
+	gen_coeff = -gen_coeff;
+
+	/* entries in this column are being erased as the elimination
+	 * is taking place, so we need to copy them first */
+	n_col = copy_column(group, inc_gen);
+	copy_row(inum_vectors);
+	n_inc = inum_vectors->num_entries;
+
+	for (i = 0; i < n_col; i++) {
+		if (col_indices[i] == gen) continue;
+		if (add_diff_rows(group, col_indices[i], gen,
+				col_values[i] * gen_coeff)) break;
+	}
+
+	if (i < n_col) {
+		/* some entry became too big. The row gen is
+		 * still intact, so the additions can be undone */
+		while (i-- > 0) {
+			if (col_indices[i] == gen) continue;
+			if (add_diff_rows(group, col_indices[i], gen,
+					- col_values[i] * gen_coeff))
+				ERR_BAIL("eliminate_pivot: cannot undo")
+		}
+
+		/* leave this pivot to PARI */
+		matr_precision[group - 1] = PREC_PARI;
+		return 0;
+	}
+
+	/* a single entry should remain in this column by now ... */
+	if (matr_column(cplx_matrices + group - 1, inc_gen)->num_entries != 1)
+		ERR_BAIL(gen_error);
+	if (incl_matrices != NULL)
+		track_pivot(group, gen, inc_gen, gen_coeff, n_inc, n_col);
+	kill_gen(group - 1, inc_gen);
+
+	/* ... and now it has to be gone from the row too */
+	if (inum_vectors->num_entries != n_inc - 1) ERR_BAIL(gen_error);
+	kill_gen(group, gen);
+
+	return 1;
+}
+
+/*
+ * Eliminate as many generators as possible in a given group (or only in
+ * a given component, if comp is not negative).
+ * Return 1 if some elimination was done and 0 otherwise.
+ * If do_short is set, only consider generators with at most 2 incident ones.
+ */
+static int eliminate_gens(SM_complex_t group, SM_index_t comp, int do_short)
+{
+	SM_index_t elim_cnt = 0, gen, inc_gen;
+	SM_index_t k, n_gens = cplx_group_ranks[group], *gens = NULL;
+	SM_value_t gen_coeff;
+	int isfound = 0;
+
+	SparseVector *inum_vectors;
+
+	if (time_is_up()) return 0;
+
+	/* check that the differential matrices are already initialized */
+	if (group > first_group + 1 && cplx_matrices[group - 2].rows == 0)
+		init_diff_matrix(group - 2);
+	if (group > first_group && cplx_matrices[group - 1].rows == 0)
+		init_diff_matrix(group - 1);
+	if (group < last_group && cplx_matrices[group].rows == 0)
+		init_diff_matrix(group);
+
+	/* only eliminate_pivot keeps track of the change of basis */
+#ifdef DENSE_FILL
+	if (! do_short && incl_matrices == NULL &&
+			matr_precision[group - 1] == PREC_DENSE &&
+			is_matr_dense(group - 1, comp) &&
+			eliminate_dense(group, comp) == 0)
+		return 0;
+#endif
+
+#ifdef SPLIT_COMPONENTS
+	if (comp >= 0) gens = comp_range(comp, group, &n_gens);
+#endif
+
+#ifdef ELIM_THREADS
+	/* the stale lists of rows of a matrix stored by rows only are
+	 * compacted by reading rows that other threads may be changing */
+	if (! do_short && incl_matrices == NULL && n_gens >= THREADS_MIN_GENS &&
+			! cplx_matrices[group - 1].rows_only)
+		return eliminate_parallel(group, gens, n_gens);
+#endif
+
+	/* searching for invertible entries across rows is for some reason
+	 * _much_ faster than down columns, especially when do_short is set */
+	for (k = 0; k < n_gens && ! time_is_up(); k++) {
+		gen = (gens == NULL) ? k + 1 : gens[k] - gen_offsets[group] + 1;
+		inum_vectors = cplx_matrices[group - 1].rows + gen - 1;
+
+		if (inum_vectors->num_entries == -1) continue; // already gone
+		if (do_short && (inum_vectors->num_entries > 2)) continue;
+
+		inc_gen = find_v_unit(inum_vectors, &gen_coeff);
+		/* should be impossible after the previous check */
+		// if (inc_gen == ERR_MVAL) bailout ();
+
+		if (inc_gen == 0) continue; // no invertible incidence numbers
+
+		if (eliminate_pivot(group, gen, inc_gen, gen_coeff) == 0)
+			continue;
+
+		elim_cnt++;
+		isfound = 1;
+	}
+
+#ifdef PRINT_REDSTAT
+	if (isfound) printf("%d | ", elim_cnt);
+#endif
+
+	return isfound;
+}
+
+/*
+ * Eliminate as many generators as possible in a given group (or only in
+ * a given component, if comp is not negative).
+ */
+static void reduce_group(SM_complex_t group, SM_index_t comp)
+{
+	/* the number of successful iterations for the group */
+	int cnt_short = 0, cnt_full = 0;
+
+#ifdef PRINT_REDSTAT
+	if (comp < 0) printf("%d: ", group);
+#endif
+	/* eliminate as many generators in this group as possible,
+	 * repeat the procedure if something was eliminated */
+	while (eliminate_gens(group, comp, 1)) cnt_short++;
+	while (eliminate_gens(group, comp, 0)) cnt_full++;
+#ifdef PRINT_REDSTAT
+	if (comp < 0) printf("%d+%d%s;  ", cnt_short, cnt_full,
+		matr_precision[group - 1] == PREC_PARI ? " (big)" : "");
+#endif
+}
+
+/*
+ * Eliminate as many generators as possible in all the non-empty groups,
+ * sweeping through them one by one. If the complex is split, all the
+ * components spanning a group are reduced there before moving on, so that
+ * the matrices left behind are final and can be exported to PARI.
+ */
+static void reduce_sweep(void)
+{
+	SM_complex_t group;
+#ifdef SPLIT_COMPONENTS
+	SM_index_t comp;
+
+	comp_spans = (SM_complex_t *)
+			malloc(2 * (num_comps + 1) * sizeof(SM_complex_t));
+	if (comp_spans == NULL) ERR_BAIL("reduce_sweep: not enough memory")
+
+	for (comp = 0; comp < num_comps; comp++)
+		comp_groups(comp, comp_spans + 2 * comp,
+						comp_spans + 2 * comp + 1);
+#elif defined(PRINT_REDSTAT)
+	printf("\n   ");
+#endif
+
+	/* a resumed sweep starts from the group it was stopped at */
+	if (sweep_group <= first_group) sweep_group = first_group + 1;
+
+	for (group = sweep_group; group <= last_group && ! is_stopped;
+								group++) {
+		sweep_group = group;
+#ifdef SPLIT_COMPONENTS
+		for (comp = 0; comp < num_comps; comp++)
+			if (comp_spans[2 * comp] < group &&
+					group <= comp_spans[2 * comp + 1])
+				reduce_group(group, comp);
+#else
+		reduce_group(group, -1);
+#endif
+
+#ifdef EARLY_EXPORT
+		/* nothing changes the matrices before group - 1 from now on,
+		 * unless the reduction is to be stopped and saved midway (and
+		 * PARI can't be used from the background thread at all) */
+		if (group - 2 >= first_group && deadline == 0 && ! bg_active)
+			export_matrix(group - 2);
+#endif
+	}
+}
+
+/*
+ * Estimate the fill-in caused by eliminating a generator of a given group
+ * (that is, the number of entries of its differential matrix changed) by the
+ * Markowitz count: (entries in the row - 1) * (entries in the column - 1).
+ * The invertible entry in the generator's row with the shortest column is
+ * chosen, and its column and value are stored in *inc_gen and *gen_coeff.
+ * Return -1 if the row has no invertible entries.
+ */
+static long pivot_cost(SM_complex_t group, SM_index_t gen,
+				SM_index_t *inc_gen, SM_value_t *gen_coeff)
+{
+	SparseMatrix *matr = cplx_matrices + group - 1;
+	SparseVector *row = matr->rows + gen - 1;
+	SM_index_t i, col_len, min_len = -1;
+	SM_value_t val;
+
+	for (i = 0; i < row->num_entries; i++) {
+		val = get_v_value(row, i);
+		if (! is_val_unit(val)) continue;
+
+		col_len = matr_column(matr, row->indices[i])->num_entries;
+		if (min_len == -1 || col_len < min_len) {
+			min_len = col_len;
+			*inc_gen = row->indices[i];
+			*gen_coeff = val;
+		}
+	}
+
+	if (min_len == -1) return -1;
+	return (long) (row->num_entries - 1) * (min_len - 1);
+}
+
+/*
+ * Compare two queued pivots: cheaper ones go first, ties are broken by the
+ * group and the generator's number to keep the order deterministic.
+ */
+static int pivot_before(QueuedGen *piv1, QueuedGen *piv2)
+{
+	if (piv1->cost != piv2->cost) return piv1->cost < piv2->cost;
+	if (piv1->group != piv2->group) return piv1->group < piv2->group;
+	return piv1->gen < piv2->gen;
+}
+
+/*
+ * Put a generator of a given group into the pivot queue (a binary heap),
+ * provided that it has an invertible incidence number.
+ */
+static void queue_pivot(SM_complex_t group, SM_index_t gen)
+{
+	QueuedGen new_piv, *new_queue;
+	SM_index_t inc_gen;
+	SM_value_t gen_coeff;
+	long pos, parent;
+
+	if ((new_piv.cost = pivot_cost(group, gen, &inc_gen, &gen_coeff)) < 0)
+		return;
+	new_piv.group = group;
+	new_piv.gen = gen;
+
+	if (queue_len == queue_room) {
+		queue_room = (queue_room == 0) ? 1024 : 2 * queue_room;
+		new_queue = (QueuedGen *)
+			realloc(pivot_queue, queue_room * sizeof(QueuedGen));
+		if (new_queue == NULL)
+			ERR_BAIL("queue_pivot: not enough memory")
+		pivot_queue = new_queue;
+	}
+
+	/* sift the new pivot up */
+	for (pos = queue_len++; pos > 0; pos = parent) {
+		parent = (pos - 1) / 2;
+		if (! pivot_before(&new_piv, pivot_queue + parent)) break;
+		pivot_queue[pos] = pivot_queue[parent];
+	}
+	pivot_queue[pos] = new_piv;
+}
+
+/*
+ * Remove the cheapest pivot from the queue and store it in *top.
+ */
+static void unqueue_pivot(QueuedGen *top)
+{
+	QueuedGen last;
+	long pos, child;
+
+	*top = pivot_queue[0];
+	last = pivot_queue[--queue_len];
+
+	/* sift the last pivot down from the root */
+	for (pos = 0; (child = 2 * pos + 1) < queue_len; pos = child) {
+		if (child + 1 < queue_len &&
+			pivot_before(pivot_queue + child + 1, pivot_queue + child))
+			child++;
+		if (! pivot_before(pivot_queue + child, &last)) break;
+		pivot_queue[pos] = pivot_queue[child];
+	}
+	if (queue_len > 0) pivot_queue[pos] = last;
+}
+
+/*
+ * Eliminate as many generators as possible in all the non-empty groups
+ * (or only in a given component, if comp is not negative), taking the
+ * pivots from a single queue in the order of their estimated fill-in.
+ *
+ * The costs in the queue are updated lazily: a pivot is re-queued when it
+ * turns out to be more expensive than expected, and generators whose rows
+ * are changed by an elimination are queued anew, since they might have got
+ * invertible incidence numbers.
+ */
+static void reduce_queue(SM_index_t comp)
+{
+	SM_complex_t group, first = first_group, last = last_group;
+	SM_index_t k, n_gens, *gens = NULL, inc_gen, n_rows;
+	SM_value_t gen_coeff;
+	QueuedGen top;
+	long cost;
+
+	number_gens();
+#ifdef SPLIT_COMPONENTS
+	if (comp >= 0) comp_groups(comp, &first, &last);
+#endif
+
+	for (group = first + 1; group <= last; group++) {
+		n_gens = cplx_group_ranks[group];
+#ifdef SPLIT_COMPONENTS
+		if (comp >= 0) gens = comp_range(comp, group, &n_gens);
+#endif
+		for (k = 0; k < n_gens; k++)
+			queue_pivot(group, (gens == NULL) ? k + 1 :
+					gens[k] - gen_offsets[group] + 1);
+	}
+
+	while (queue_len > 0 && ! time_is_up()) {
+		unqueue_pivot(&top);
+		if (cplx_matrices[top.group - 1].rows[top.gen - 1].num_entries
+				<= 0) continue; // gone or nothing there
+
+		cost = pivot_cost(top.group, top.gen, &inc_gen, &gen_coeff);
+		if (cost < 0) continue; // no invertible incidence numbers
+		if (cost > top.cost) {
+			/* something cheaper might be there by now */
+			queue_pivot(top.group, top.gen);
+#ifdef PRINT_REDSTAT
+			queue_requeues++;
+#endif
+			continue;
+		}
+
+		/* these rows are changed by the elimination (and listed in
+		 * col_indices afterwards) */
+		n_rows = matr_column(cplx_matrices + top.group - 1, inc_gen)
+								->num_entries;
+
+		if (eliminate_pivot(top.group, top.gen, inc_gen, gen_coeff)
+				== 0) continue;
+#ifdef PRINT_REDSTAT
+		queue_elims++;
+#endif
+
+		for (k = 0; k < n_rows; k++)
+			if (col_indices[k] != top.gen)
+				queue_pivot(top.group, col_indices[k]);
+	}
+}
+
+/*
+ * Write a long to the checkpoint file being written.
+ */
+static void put_long(long num)
+{
+	if (fwrite(&num, sizeof(long), 1, ckpt_file) != 1)
+		ERR_BAIL("put_long: cannot write the checkpoint")
+}
+
+/*
+ * Read a long from the checkpoint file being read.
+ */
+static long get_long(void)
+{
+	long num;
+
+	if (fread(&num, sizeof(long), 1, ckpt_file) != 1)
+		ERR_BAIL("get_long: the checkpoint is corrupt")
+
+	return num;
+}
+
+/*
+ * Write a sparse matrix to the checkpoint file: its size, then every column
+ * as the number of entries (-1 if deleted) followed by the rows and values
+ * of the entries, and finally whether every row is deleted.
+ */
+static void save_matrix(SparseMatrix *matr)
+{
+	SM_index_t i, k;
+	SM_value_t val;
+	SparseVector *vec;
+
+	put_long(matr->num_rows);
+	put_long(matr->num_cols);
+
+	for (i = 0; i < matr->num_cols; i++) {
+		vec = matr_column(matr, i + 1);
+		put_long(vec->num_entries);
+		for (k = 0; k < vec->num_entries; k++) {
+			put_long(vec->indices[k]);
+			/* the rows have the values even if the columns don't */
+			if ((val = get_m_entry(matr, vec->indices[k], i + 1))
+					== ERR_MVAL)
+				bailout();
+			put_long(val);
+		}
+	}
+
+	for (i = 0; i < matr->num_rows; i++)
+		put_long(matr->rows[i].num_entries == -1);
+}
+
+/*
+ * Read a sparse matrix written by save_matrix from the checkpoint file.
+ */
+static void load_matrix(SparseMatrix *matr)
+{
+	SM_index_t i, n_rows, n_cols, row;
+	long k, n_entries;
+	SM_value_t val;
+	char *ckpt_error = "load_matrix: the checkpoint is corrupt";
+
+	n_rows = (SM_index_t) get_long();
+	n_cols = (SM_index_t) get_long();
+	if (n_rows < 0 || n_cols < 0) ERR_BAIL(ckpt_error)
+	if (init_s_matrix(matr, n_rows, n_cols) == -1) bailout();
+
+	for (i = 1; i <= n_cols; i++) {
+		if ((n_entries = get_long()) == -1) {
+			if (erase_m_column(matr, i, 1) == -1) bailout();
+			continue;
+		}
+		if (n_entries < 0 || n_entries > n_rows) ERR_BAIL(ckpt_error)
+
+		for (k = 0; k < n_entries; k++) {
+			row = (SM_index_t) get_long();
+			val = get_long();
+			if (add_m_entry(matr, row, i, val) == -1) bailout();
+		}
+	}
+
+	for (i = 1; i <= n_rows; i++)
+		if (get_long() && erase_m_row(matr, i, 1) == -1) bailout();
+
+	COUNT_ENTRIES(count_m_entries(matr, NULL, NULL))
+}
+
+/*
+ * Return the name of the temporary file a new version of a given file is
+ * written to before it replaces the old one (see replace_file). The name
+ * is to be freed afterwards.
+ */
+static char *temp_name(char *file_name)
+{
+	char *tmp_name = (char *) malloc(strlen(file_name) + 5);
+
+	if (tmp_name != NULL) sprintf(tmp_name, "%s.tmp", file_name);
+
+	return tmp_name;
+}
+
+/*
+ * Make sure that the temporary file written instead of a given one is on
+ * the disk, and put it in place of the old file. Either the old or the new
+ * version is there at every moment, even if the process is killed.
+ * Return 0 on success and -1 otherwise.
+ */
+static int replace_file(char *tmp_name, char *file_name)
+{
+	int fd;
+
+	if ((fd = open(tmp_name, O_WRONLY)) == -1) return -1;
+	if (fsync(fd) == -1) {
+		close(fd);
+		return -1;
+	}
+	close(fd);
+
+	return rename(tmp_name, file_name);
+}
+
+/*
+ * Save the current state of the reduction, so that resume_s_complex can
+ * continue it later: the ranks and the current numbers of generators,
+ * precisions and matrices of differentials, the group the sweep is at,
+ * the renumbering of the generators (if any), and the change of basis (if
+ * it's tracked). Components are found anew after resuming.
+ * The file is written under a temporary name first, so that the previous
+ * checkpoint is kept until the new one is complete.
+ */
+static void save_checkpoint(char *file_name, long schedule)
+{
+	SM_complex_t i;
+	SM_index_t n_gens;
+	uint32_t header[3] = {CKPT_MAGIC, CKPT_VERSION, sizeof(long)};
+	char *tmp_name;
+
+	/* matrices not loaded yet won't be available when resuming */
+	for (i = first_group; i < last_group; i++)
+		if (cplx_matrices[i].rows == NULL) init_diff_matrix(i);
+
+	if ((tmp_name = temp_name(file_name)) == NULL)
+		ERR_BAIL("save_checkpoint: not enough memory")
+	if ((ckpt_file = fopen(tmp_name, "wb")) == NULL) {
+		free(tmp_name);
+		ERR_BAIL("save_checkpoint: cannot open the file")
+	}
+
+	if (fwrite(header, sizeof(uint32_t), 3, ckpt_file) != 3) {
+		free(tmp_name);
+		ERR_BAIL("save_checkpoint: cannot write the checkpoint")
+	}
+	put_long(schedule);
+	put_long(cplx_size);
+	put_long(first_group);
+	put_long(last_group);
+	put_long(sweep_group);
+
+	for (i = 0; i < cplx_size; i++) {
+		put_long(cplx_group_ranks[i]);
+		put_long(num_generators[i]);
+		put_long(matr_precision[i]);
+	}
+
+	for (i = first_group; i < last_group; i++)
+		save_matrix(cplx_matrices + i);
+
+	n_gens = (gen_perm == NULL) ? 0 : gen_offsets[cplx_size];
+	put_long(n_gens);
+	for (i = 0; i < n_gens; i++) put_long(gen_perm[i]);
+
+	put_long(incl_matrices != NULL);
+	if (incl_matrices != NULL)
+		for (i = first_group; i <= last_group; i++) {
+			if (cplx_group_ranks[i] == 0) continue;
+			save_matrix(incl_matrices + i);
+			save_matrix(proj_matrices + i);
+		}
+
+	if (fclose(ckpt_file) != 0 || replace_file(tmp_name, file_name) == -1) {
+		ckpt_file = NULL;
+		remove(tmp_name);
+		free(tmp_name);
+		ERR_BAIL("save_checkpoint: cannot write the checkpoint")
+	}
+	ckpt_file = NULL;
+	free(tmp_name);
+}
+
+/*
+ * Restore the state of a reduction saved by save_checkpoint and return
+ * the schedule it was using.
+ */
+static long load_checkpoint(char *file_name)
+{
+	SM_complex_t i;
+	SM_index_t n_gens;
+	long schedule;
+	uint32_t header[3];
+	char *ckpt_error = "load_checkpoint: the checkpoint is corrupt";
+
+	if ((ckpt_file = fopen(file_name, "rb")) == NULL)
+		ERR_BAIL("load_checkpoint: cannot open the file")
+
+	if (fread(header, sizeof(uint32_t), 3, ckpt_file) != 3 ||
+			header[0] != CKPT_MAGIC)
+		ERR_BAIL(ckpt_error)
+	if (header[1] != CKPT_VERSION || header[2] != sizeof(long))
+		ERR_BAIL("load_checkpoint: the checkpoint is written by "
+				"another version or on another architecture")
+	schedule = get_long();
+	if ((i = (SM_complex_t) get_long()) < 2) ERR_BAIL(ckpt_error)
+
+	malloc_arrays(i);
+	first_group = (SM_complex_t) get_long();
+	last_group = (SM_complex_t) get_long();
+	sweep_group = (SM_complex_t) get_long();
+	if (first_group < 0 || first_group > last_group ||
+			last_group >= cplx_size)
+		ERR_BAIL(ckpt_error)
+
+	for (i = 0; i < cplx_size; i++) {
+		cplx_group_ranks[i] = (SM_index_t) get_long();
+		num_generators[i] = (SM_index_t) get_long();
+		matr_precision[i] = (char) get_long();
+	}
+
+	for (i = first_group; i < last_group; i++)
+		load_matrix(cplx_matrices + i);
+
+	if ((n_gens = (SM_index_t) get_long()) > 0) {
+		if (number_gens() != n_gens) ERR_BAIL(ckpt_error)
+
+		gen_perm = (SM_index_t *) malloc(n_gens * sizeof(SM_index_t));
+		if (gen_perm == NULL)
+			ERR_BAIL("load_checkpoint: not enough memory")
+		for (i = 0; i < n_gens; i++)
+			gen_perm[i] = (SM_index_t) get_long();
+	}
+
+	if (get_long()) {
+		incl_matrices = (SparseMatrix *)
+				calloc(cplx_size, sizeof(SparseMatrix));
+		proj_matrices = (SparseMatrix *)
+				calloc(cplx_size, sizeof(SparseMatrix));
+		if (incl_matrices == NULL || proj_matrices == NULL)
+			ERR_BAIL("load_checkpoint: not enough memory")
+
+		for (i = first_group; i <= last_group; i++) {
+			if (cplx_group_ranks[i] == 0) continue;
+			load_matrix(incl_matrices + i);
+			load_matrix(proj_matrices + i);
+		}
+	}
+
+	fclose(ckpt_file);
+	ckpt_file = NULL;
+
+	return schedule;
+}
+
+/*
+ * Eliminate as many generators as possible in a complex that is set up
+ * already, in the order given by schedule, unless the reduction is stopped
+ * (see time_is_up).
+ */
+static void run_reduction(long schedule)
+{
+#ifdef SPLIT_COMPONENTS
+	SM_index_t comp;
+
+	find_components();
+#endif
+	if (schedule == SCHED_QUEUE) {
+#ifdef SPLIT_COMPONENTS
+		for (comp = 0; comp < num_comps && ! is_stopped; comp++)
+			reduce_queue(comp);
+#else
+		reduce_queue(-1);
+#endif
+	} else
+		reduce_sweep();
+
+#ifdef PRINT_REDSTAT
+	if (schedule == SCHED_QUEUE)
+		printf("\n   pivots from the queue: %ld, re-queued: %ld",
+						queue_elims, queue_requeues);
+	printf("\n   peak number of entries: %ld, maximal entry: %ld\n",
+						peak_entries, max_entry);
+#endif
+}
+
+/*
+ * Run the reduction of a complex that is set up already. If the time budget
+ * (in seconds, 0 means no limit) runs out, save the state of the reduction
+ * into a checkpoint file and return 0 instead of the usual answer.
+ */
+static GEN finish_reduction(long schedule, long budget, char *ckpt_name)
+{
+	GEN answer;
+
+	if (budget > 0) {
+		if (ckpt_name == NULL || *ckpt_name == '\0')
+			ERR_BAIL("reduce_s_complex: no file for a checkpoint")
+		deadline = time(NULL) + budget;
+		start_gens = count_gens();
+	}
+
+	run_reduction(schedule);
+
+	if (is_stopped) {
+		save_checkpoint(ckpt_name, schedule);
+		answer = gen_0;
+	} else
+		answer = feed2pari();
+
+	cleanup();
+	return answer;
+}
+
+/*
+ * Reduce a chain complex with only free Abelian chain groups as far as
+ * possible using a sequence of elementary collapses and merging of cell.
+ *
  * Arguments are:
  *   size (length) of the complex probably without zero groups at the ends
  *   ranks of the chain groups
  *   matrices of chain differentials in the sparse format
  *   lengths of arrays representing the matrices
+ *   ordering of generators to apply before the reduction: 0 (none),
+ *     1 (minimum degree), or 2 (reverse Cuthill-McKee)
+ *   order of eliminations: 0 (group by group) or 1 (cheapest pivot of
+ *     the whole complex first)
+ *   name of the file the matrices were spilled to by spill_matrix, in
+ *     which case they are given by their offsets there (or "" if none)
+ *   time budget in seconds (0 for no limit)
+ *   name of the file to save the state of the reduction to, if the budget
+ *     runs out before it's finished
+ *   whether to keep track of the change of basis (0 or 1)
  *
  * The return value is a 2-component vector which contain
  *   ranks of the chain groups after the reduction
  *   matrices of chain differentials after the reduction
  *     (matrices of size 0 are substituted with 0 for better visualization)
+ *
+ * If the change of basis is tracked, two more components follow:
+ *   for every chain group, the generators left after the reduction
+ *     expressed in the original ones (as columns of a matrix)
+ *   for every chain group, the projection of the original generators
+ *     onto the ones left (a chain map inverse to the above up to homotopy)
+ * Both are recorded sparsely along with the eliminations, so no dense
+ * inversion is needed, but the dense and the parallel eliminations are not
+ * used then.
+ *
+ * If the budget runs out, 0 is returned instead and the reduction can be
+ * continued by resume_s_complex, even in another session. The checkpoint
+ * file is never removed here (see remove_checkpoint).
+ *
+ * Eliminations that would produce entries not fitting into SM_value_t are
+ * skipped, so such pivots remain in the matrices returned. PARI deals with
+ * them later using its own multiprecision arithmetic.
  */
-GEN reduce_s_complex(long c_size, GEN c_ranks, GEN d_matrices, GEN matr_lengths)
+GEN reduce_s_complex(long c_size, GEN c_ranks, GEN d_matrices,
+		GEN matr_lengths, long order, long schedule, char *spill_name,
+		long budget, char *ckpt_name, long track)
 {
 	GEN answer;
-	SM_complex_t group;
-	int cnt_short, cnt_full;
+
+	/* the internal state is taken by the background reduction */
+	if (bg_active)
+		pari_err(talker, "reduce_s_complex: reduction is in progress");
 
 	malloc_arrays((SM_complex_t) c_size);
 	pari_matrices = d_matrices;
 	num_entries = matr_lengths;
+	init_result(track != 0);
+	if (spill_name != NULL && *spill_name != '\0') map_spill(spill_name);
 
 	if (init_ranks(c_ranks) == -1) {
 		/* complex is empty */
@@ -505,25 +2740,420 @@ GEN reduce_s_complex(long c_size, GEN c_ranks, GEN d_matrices, GEN matr_lengths)
 		return answer;
 	}
 
+	order_gens(order);
+	if (track) init_tracking();
 #ifdef PRINT_REDSTAT
-	printf("\n   ");
-#endif
-	for (group = first_group + 1; group <= last_group; group++) {
-		/* the number of successful iterations for each group */
-		cnt_short = cnt_full = 0;
-#ifdef PRINT_REDSTAT
-		printf("%d: ", group);
+	printf("\n   ordering of generators: %ld, schedule: %ld",
+							order, schedule);
 #endif
-		/* eliminate as many generators in this group as possible,
-		 * repeat the procedure if something was eliminated */
-		while (eliminate_gens(group, 1)) cnt_short++;
-		while (eliminate_gens(group, 0)) cnt_full++;
+
+	return finish_reduction(schedule, budget, ckpt_name);
+}
+
+/*
+ * Continue a reduction stopped by reduce_s_complex (or by this function
+ * itself) from the checkpoint file it left, with a new time budget (in
+ * seconds, 0 for no limit). If the budget runs out again, a new checkpoint
+ * replaces the old one. The checkpoint stays in place even if the reduction
+ * is finished, until the caller has stored the result and removes it.
+ *
+ * The return value is the same as for reduce_s_complex.
+ */
+GEN resume_s_complex(char *ckpt_name, long budget)
+{
+	long schedule;
+
+	if (bg_active)
+		pari_err(talker, "resume_s_complex: reduction is in progress");
+
+	schedule = load_checkpoint(ckpt_name);
+
+	init_result(incl_matrices != NULL);
+
 #ifdef PRINT_REDSTAT
-		printf("%d+%d;  ", cnt_short, cnt_full);
+	printf("\n   resuming the reduction, schedule: %ld", schedule);
 #endif
+
+	return finish_reduction(schedule, budget, ckpt_name);
+}
+
+/*
+ * Save a PARI object (the results of the reduction kept by the caller) into
+ * a file in PARI's binary format. The file is replaced at once, so that
+ * either its old or its new version is there, even if the process is
+ * killed while writing.
+ */
+void save_red_state(char *file_name, GEN state)
+{
+	char *tmp_name;
+
+	if ((tmp_name = temp_name(file_name)) == NULL)
+		pari_err(talker, "save_red_state: not enough memory");
+
+	/* writebin appends to a file that exists already */
+	if (remove(tmp_name) == -1 && errno != ENOENT) {
+		free(tmp_name);
+		pari_err(talker, "save_red_state: cannot write to the file");
+	}
+	writebin(tmp_name, state);
+
+	if (replace_file(tmp_name, file_name) == -1) {
+		remove(tmp_name);
+		free(tmp_name);
+		pari_err(talker, "save_red_state: cannot write to the file");
+	}
+	free(tmp_name);
+}
+
+/*
+ * Read a PARI object saved by save_red_state. Return 0 if there is no such
+ * file.
+ */
+GEN load_red_state(char *file_name)
+{
+	if (access(file_name, F_OK) == -1) return gen_0;
+
+	return gp_read_file(file_name);
+}
+
+/*
+ * Remove a checkpoint file written by reduce_s_complex or save_red_state
+ * (if there is one).
+ */
+void remove_checkpoint(char *file_name)
+{
+	if (remove(file_name) == -1 && errno != ENOENT)
+		pari_err(talker, "remove_checkpoint: cannot remove the file");
+}
+
+#ifdef BACKGROUND_RED
+/*
+ * Body of the background thread started by start_s_complex.
+ */
+static void *reduce_background(void *arg)
+{
+	if (first_group >= 0) run_reduction(bg_schedule);
+
+	pthread_mutex_lock(&bg_lock);
+	bg_status = BG_FINISHED;
+	bg_gens = count_gens();
+	pthread_mutex_unlock(&bg_lock);
+
+	return NULL;
+}
+
+/*
+ * Start reducing a chain complex in a background thread and return right
+ * away. Arguments are the same as for reduce_s_complex, except that there is
+ * no time budget. All the matrices are read before the thread starts, so
+ * the ones given can be discarded afterwards, but PARI can't be used in the
+ * thread, so the matrices are only sent back by wait_s_complex.
+ *
+ * Only one reduction can be done at a time, either this one or the one by
+ * reduce_s_complex.
+ */
+void start_s_complex(long c_size, GEN c_ranks, GEN d_matrices,
+		GEN matr_lengths, long order, long schedule, char *spill_name,
+		long track)
+{
+	if (bg_active)
+		pari_err(talker, "start_s_complex: reduction is in progress");
+
+	malloc_arrays((SM_complex_t) c_size);
+	pari_matrices = d_matrices;
+	num_entries = matr_lengths;
+	if (spill_name != NULL && *spill_name != '\0') map_spill(spill_name);
+
+	if (init_ranks(c_ranks) == 0) {
+		order_gens(order);
+		if (track) init_tracking();
+		/* load all the matrices while PARI can still be used */
+		number_gens();
+	}
+	pari_matrices = num_entries = NULL;
+
+	bg_schedule = schedule;
+	bg_status = BG_RUNNING;
+	start_gens = bg_gens = count_gens();
+
+	/* the thread has to know it's in the background from the start */
+	bg_active = 1;
+	if (pthread_create(&bg_thread, NULL, reduce_background, NULL) != 0) {
+		bg_active = 0;
+		ERR_BAIL("start_s_complex: cannot start a thread")
+	}
+}
+
+/*
+ * Report the progress of the reduction in the background. The return value
+ * is a 3-component vector which contains
+ *   state of the reduction: 0 (there is none), 1 (running), 2 (finished),
+ *     or 3 (stopped by an error)
+ *   number of generators when it was started
+ *   number of generators left by now
+ */
+GEN poll_s_complex(void)
+{
+	GEN progress = cgetg(4, t_VEC);
+
+	pthread_mutex_lock(&bg_lock);
+	progress[1] = (long)stoi(bg_status);
+	progress[2] = (long)stoi(bg_active ? start_gens : 0);
+	progress[3] = (long)stoi(bg_active ? bg_gens : 0);
+	pthread_mutex_unlock(&bg_lock);
+
+	return progress;
+}
+
+/*
+ * Wait for the reduction in the background to finish and return the same as
+ * reduce_s_complex (or 0 if it's cancelled). If the reduction was stopped
+ * by an error, report it now.
+ */
+GEN wait_s_complex(void)
+{
+	GEN answer;
+
+	if (! bg_active)
+		pari_err(talker, "wait_s_complex: no reduction is in progress");
+
+	pthread_join(bg_thread, NULL);
+	bg_active = 0;
+
+	if (bg_status == BG_FAILED) ERR_BAIL(bg_error)
+
+	if (is_stopped)
+		answer = gen_0;
+	else {
+		init_result(incl_matrices != NULL);
+		answer = feed2pari();
 	}
 
-	answer = feed2pari();
 	cleanup();
 	return answer;
 }
+
+/*
+ * Stop the reduction in the background (if there is any) and discard it.
+ */
+void cancel_s_complex(void)
+{
+	if (! bg_active) return;
+
+	pthread_mutex_lock(&bg_lock);
+	bg_cancel = 1;
+	pthread_mutex_unlock(&bg_lock);
+
+	pthread_join(bg_thread, NULL);
+	cleanup();
+}
+#endif // #ifdef BACKGROUND_RED
+
+/*
+ * Names of the files created by spill_matrix in this process. Only these
+ * are ever appended to or removed, so that several sessions sharing the
+ * same directory never touch each other's files.
+ */
+static char **own_spills = NULL;
+static int num_own_spills = 0;
+
+/*
+ * Return the position of a file in own_spills, or -1 if it's not there.
+ */
+static int find_own_spill(char *file_name)
+{
+	int i;
+
+	for (i = 0; i < num_own_spills; i++)
+		if (strcmp(own_spills[i], file_name) == 0) return i;
+
+	return -1;
+}
+
+/*
+ * Return the name of the file to spill the matrices of a given data
+ * position to. It's unique for every process, see own_spills.
+ */
+GEN spill_file_name(char *dir_name, long datapos)
+{
+	char *file_name;
+	GEN answer;
+
+	file_name = (char *) malloc(strlen(dir_name) + 64);
+	if (file_name == NULL)
+		pari_err(talker, "spill_file_name: not enough memory");
+
+	sprintf(file_name, "%s/KhoHo_matr_%ld_%ld.bin", dir_name,
+						(long) getpid(), datapos);
+	answer = strtoGENstr(file_name);
+	free(file_name);
+
+	return answer;
+}
+
+/*
+ * Append a matrix in the packed format to a file, so that reduce_s_complex
+ * can map it into memory later instead of it being kept on PARI's stack.
+ * Return the offset (in words) of the matrix in the file.
+ * The file must either be created here, or have been created by an earlier
+ * call in this process.
+ */
+long spill_matrix(char *file_name, GEN matr)
+{
+	FILE *spill_file;
+	long offset = 0, n_words = lg(matr);
+	char **new_spills;
+	int fd;
+
+	if (typ(matr) != t_VECSMALL)
+		pari_err(talker, "spill_matrix: matrix is not in the packed format");
+
+	if (find_own_spill(file_name) == -1) {
+		new_spills = (char **) realloc(own_spills,
+				(num_own_spills + 1) * sizeof(char *));
+		if (new_spills == NULL)
+			pari_err(talker, "spill_matrix: not enough memory");
+		own_spills = new_spills;
+
+		/* never reuse a file left by somebody else */
+		fd = open(file_name, O_WRONLY | O_CREAT | O_EXCL, 0600);
+		if (fd == -1 && errno == EEXIST)
+			pari_err(talker, "spill_matrix: the file exists already");
+		if (fd == -1 || (spill_file = fdopen(fd, "ab")) == NULL) {
+			if (fd != -1) close(fd);
+			pari_err(talker, "spill_matrix: cannot open the file");
+		}
+
+		own_spills[num_own_spills] =
+				(char *) malloc(strlen(file_name) + 1);
+		if (own_spills[num_own_spills] == NULL) {
+			fclose(spill_file);
+			remove(file_name);
+			pari_err(talker, "spill_matrix: not enough memory");
+		}
+		strcpy(own_spills[num_own_spills++], file_name);
+	} else if ((spill_file = fopen(file_name, "ab")) == NULL)
+		pari_err(talker, "spill_matrix: cannot open the file");
+
+	if (fseek(spill_file, 0, SEEK_END) == -1 ||
+			(offset = ftell(spill_file)) == -1 ||
+			offset % sizeof(long) != 0 ||
+			fwrite(matr, sizeof(long), n_words, spill_file)
+				!= (size_t) n_words) {
+		fclose(spill_file);
+		pari_err(talker, "spill_matrix: cannot write to the file");
+	}
+
+	if (fclose(spill_file) != 0)
+		pari_err(talker, "spill_matrix: cannot write to the file");
+
+	return offset / sizeof(long);
+}
+
+/*
+ * Remove a file with matrices written by spill_matrix (if there is one).
+ * Files not created by spill_matrix in this process are left alone.
+ */
+void unspill_matrices(char *file_name)
+{
+	int i = find_own_spill(file_name);
+
+	if (i == -1) return;
+
+	free(own_spills[i]);
+	own_spills[i] = own_spills[--num_own_spills];
+
+	if (remove(file_name) == -1 && errno != ENOENT)
+		pari_err(talker, "unspill_matrices: cannot remove the file");
+}
+
+/*
+ * An entry of a matrix being compressed.
+ */
+typedef struct {
+	SM_index_t row, column;
+	int is_neg;
+} PackedEntry;
+
+/*
+ * Compare two entries of a matrix: by columns first, then by rows.
+ */
+static int compare_entries(const void *entry1, const void *entry2)
+{
+	const PackedEntry *ent1 = entry1, *ent2 = entry2;
+
+	if (ent1->column != ent2->column)
+		return (ent1->column < ent2->column) ? -1 : 1;
+	if (ent1->row != ent2->row) return (ent1->row < ent2->row) ? -1 : 1;
+	return ent1->is_neg - ent2->is_neg;
+}
+
+/*
+ * Compress a matrix in the packed format (see assign_matrix). Its entries
+ * are sorted by columns and then rows, and turned into a stream of numbers:
+ * for every column that has entries, the difference with the previous such
+ * column and the number of its entries, followed by the differences of rows
+ * of the entries with the previous ones (starting from 0), doubled and
+ * increased by 1 if the value is -1. The numbers are stored in the LEB128
+ * encoding (see read_varint), so that most of them take a single byte.
+ *
+ * The result is a VECSMALL with 0 (that can't start a packed matrix), the
+ * number of entries and of the bytes in the stream, and the stream itself.
+ * Matrices that are compressed already are returned as they are.
+ */
+GEN compress_matrix(GEN matr)
+{
+	long i, j, n_entries, n_bytes;
+	PackedEntry *entries;
+	unsigned char *stream, *ptr;
+	GEN GEN_ptr = matr + 1, result;
+	char *mem_error = "compress_matrix: not enough memory";
+
+	if (typ(matr) != t_VECSMALL)
+		pari_err(talker, "compress_matrix: matrix is not in the packed format");
+
+	n_entries = (lg(matr) - 1) / PACKED_WORDS;
+	if (n_entries == 0 || matr[1] == 0) return matr;
+
+	entries = (PackedEntry *) malloc(n_entries * sizeof(PackedEntry));
+	if (entries == NULL) pari_err(talker, mem_error);
+	for (i = 0; i < n_entries; i++)
+		entries[i].is_neg = (unpack_entry(&GEN_ptr, &entries[i].row,
+						&entries[i].column) < 0);
+	qsort(entries, n_entries, sizeof(PackedEntry), compare_entries);
+
+	/* every number takes at most 5 bytes */
+	stream = (unsigned char *) malloc(15 * n_entries);
+	if (stream == NULL) {
+		free(entries);
+		pari_err(talker, mem_error);
+	}
+
+	for (i = 0, ptr = stream; i < n_entries; i = j) {
+		for (j = i + 1; j < n_entries &&
+			entries[j].column == entries[i].column; j++);
+
+		write_varint(&ptr, entries[i].column -
+				((i == 0) ? 0 : entries[i - 1].column));
+		write_varint(&ptr, j - i);
+		write_varint(&ptr, 2 * (unsigned long) entries[i].row +
+							entries[i].is_neg);
+		for (i++; i < j; i++)
+			write_varint(&ptr, 2 * (unsigned long)
+				(entries[i].row - entries[i - 1].row) +
+							entries[i].is_neg);
+	}
+	n_bytes = ptr - stream;
+	free(entries);
+
+	result = cgetg(4 + (n_bytes + sizeof(long) - 1) / sizeof(long),
+								t_VECSMALL);
+	result[1] = 0;
+	result[2] = n_entries;
+	result[3] = n_bytes;
+	result[lg(result) - 1] = 0;	// no garbage in the last word
+	memcpy(result + 4, stream, n_bytes);
+	free(stream);
+
+	return result;
+}